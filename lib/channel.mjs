@@ -18,6 +18,13 @@ const bool = {
 /**
  * Remove alpha channels, if any. This is a no-op if the image does not have an alpha channel.
  *
+ * Use the `ifOpaque` option to remove alpha channels only when every pixel is fully opaque,
+ * e.g. a PNG image saved with an unused alpha channel.
+ * This avoids the need to premultiply before, and unpremultiply after, resize, blur, convolve and sharpen,
+ * at the cost of decoding the image into memory to check the value of every pixel.
+ * Alpha channels are therefore kept when none of these operations are used,
+ * or when the loader indicates transparency, e.g. a palette-based PNG image with a tRNS chunk.
+ *
  * See also {@link /api-operation/#flatten flatten}.
  *
  * @example
@@ -27,9 +34,33 @@ const bool = {
  *     // rgb.png is a 3 channel image without an alpha channel
  *   });
  *
+ * @example
+ * // Output has an alpha channel only when the input has transparent pixels
+ * const { info } = await sharp(input)
+ *   .removeAlpha({ ifOpaque: true })
+ *   .resize(320)
+ *   .toBuffer({ resolveWithObject: true });
+ *
+ * @param {Object} [options]
+ * @param {boolean} [options.ifOpaque=false] - remove alpha channels only when fully opaque.
  * @returns {Sharp}
+ * @throws {Error} Invalid parameters
  */
-function removeAlpha () {
+function removeAlpha (options) {
+  if (is.defined(options)) {
+    if (!is.object(options)) {
+      throw is.invalidParameterError('options', 'object', options);
+    }
+    if (is.defined(options.ifOpaque)) {
+      if (!is.bool(options.ifOpaque)) {
+        throw is.invalidParameterError('ifOpaque', 'boolean', options.ifOpaque);
+      }
+      if (options.ifOpaque) {
+        this.options.removeAlphaIfOpaque = true;
+        return this;
+      }
+    }
+  }
   this.options.removeAlpha = true;
   return this;
 }
@@ -166,10 +166,21 @@ const queueListener = (queueLength) => {
  * @param {boolean} [options.unlimited=false] - Set this to `true` to remove safety features that help prevent memory exhaustion (JPEG, PNG, SVG, HEIF).
  * @param {boolean} [options.autoOrient=false] - Set this to `true` to rotate/flip the image to match EXIF `Orientation`, if any.
  * @param {boolean} [options.sequentialRead=true] - Set this to `false` to use random access rather than sequential read. Some operations will do this automatically.
+ * @param {boolean} [options.incremental=false] - For Stream-based input, set this to `true` to start decoding as soon as output is requested rather than waiting for the Writable side to finish,
+ *  reducing latency and memory usage. Writes complete once no more than the `writableHighWaterMark` of data awaits decoding.
+ *  Formats that require random access, e.g. TIFF, are buffered by libvips.
+ *  Each pending decode occupies a worker thread while waiting for data. Not supported by `metadata()`, `stats()` or `clone()` once started.
+ * @param {AbortSignal} [options.signal] - Stop processing when this signal is aborted.
+ *  Tasks waiting for a worker thread are removed from the queue, running tasks are stopped at the next progress update.
+ *  Destroying Stream-based output also stops processing.
  * @param {number} [options.density=72] - The DPI at which to render SVG and PDF images, in the range 1 to 100000.
  * @param {number} [options.ignoreIcc=false] - should the embedded ICC profile, if any, be ignored.
+ * @param {boolean} [options.skipStandardIcc=false] - should conversion be skipped when the embedded ICC profile is equivalent to sRGB,
+ *  or Display P3 for 16-bit input, identified by its colourants and tone curves. Reported as `iccSkipped` in the output `info`.
+ * @param {boolean} [options.embeddedThumbnail=false] - when resizing, should the thumbnail embedded in HEIF/AVIF images or in the EXIF data of JPEG images
+ *  be used instead of the main image, if it has the same aspect ratio and is at least as large as the output. Reported as `embeddedThumbnail` in the output `info`.
  * @param {number} [options.pages=1] - Number of pages to extract for multi-page input (GIF, WebP, TIFF), use -1 for all pages.
- * @param {number} [options.page=0] - Page number to start extracting from for multi-page input (GIF, WebP, TIFF), zero based.
+ * @param {number} [options.page=0] - Page number to start extracting from for multi-page input (GIF, WebP, TIFF), zero based. When resizing a pyramidal TIFF stored as pages, or JPEG 2000, defaults to the smallest page with enough pixels for the output.
  * @param {boolean} [options.animated=false] - Set to `true` to read all frames/pages of an animated image (GIF, WebP, TIFF), equivalent of setting `pages` to `-1`.
  * @param {Object} [options.raw] - describes raw pixel input image data. See `raw()` for pixel ordering.
  * @param {number} [options.raw.width] - integral number of pixels wide.
@@ -208,14 +219,14 @@ const queueListener = (queueLength) => {
  * @param {string} [options.join.halign='left'] - horizontal alignment style for images joined horizontally (`'left'`, `'centre'`, `'center'`, `'right'`).
  * @param {string} [options.join.valign='top'] - vertical alignment style for images joined vertically (`'top'`, `'centre'`, `'center'`, `'bottom'`).
  * @param {Object} [options.tiff] - Describes TIFF specific options.
- * @param {number} [options.tiff.subifd=-1] - Sub Image File Directory to extract for OME-TIFF, defaults to main image.
+ * @param {number} [options.tiff.subifd=-1] - Sub Image File Directory to extract for OME-TIFF, defaults to main image. When resizing, defaults to the smallest sub-IFD with enough pixels for the output.
  * @param {Object} [options.svg] - Describes SVG specific options.
  * @param {string} [options.svg.stylesheet] - Custom CSS for SVG input, applied with a User Origin during the CSS cascade.
  * @param {boolean} [options.svg.highBitdepth=false] - Set to `true` to render SVG input at 32-bits per channel (128-bit) instead of 8-bits per channel (32-bit) RGBA.
  * @param {Object} [options.pdf] - Describes PDF specific options. Requires the use of a globally-installed libvips compiled with support for PDFium, Poppler, ImageMagick or GraphicsMagick.
  * @param {string|Object} [options.pdf.background] - Background colour to use when PDF is partially transparent. Parsed by the [color](https://www.npmjs.org/package/color) module to extract values for red, green, blue and alpha.
  * @param {Object} [options.openSlide] - Describes OpenSlide specific options. Requires the use of a globally-installed libvips compiled with support for OpenSlide.
- * @param {number} [options.openSlide.level=0] - Level to extract from a multi-level input, zero based.
+ * @param {number} [options.openSlide.level=0] - Level to extract from a multi-level input, zero based. When not set and resizing, defaults to the smallest level with enough pixels for the output.
  * @param {Object} [options.jp2] - Describes JPEG 2000 specific options. Requires the use of a globally-installed libvips compiled with support for OpenJPEG.
  * @param {boolean} [options.jp2.oneshot=false] - Set to `true` to decode tiled JPEG 2000 images in a single operation, improving compatibility.
  * @returns {Sharp}
@@ -312,6 +323,7 @@ const Sharp = function (input, options) {
     joinChannelIn: [],
     extractChannel: -1,
     removeAlpha: false,
+    removeAlphaIfOpaque: false,
     ensureAlpha: -1,
     colourspace: 'srgb',
     colourspacePipeline: 'last',
@@ -321,6 +333,7 @@ const Sharp = function (input, options) {
     formatOut: 'input',
     streamOut: false,
     typedArrayOut: false,
+    typedArrayTransferable: true,
     keepMetadata: 0,
     withMetadataOrientation: -1,
     withMetadataDensity: 0,
@@ -412,6 +425,12 @@ const Sharp = function (input, options) {
     tileId: 'https://example.com/iiif',
     tileBasename: '',
     timeoutSeconds: 0,
+    schedulePriority: 'interactive',
+    scheduleLatency: 'short',
+    scheduleConcurrency: 0,
+    incrementalOut: false,
+    timings: false,
+    explain: false,
     linearA: [],
     linearB: [],
     pdfBackground: [255, 255, 255, 255],
@@ -424,6 +443,13 @@ const Sharp = function (input, options) {
     queueListener
   };
   this.options.input = this._createInputDescriptor(input, options, { allowStream: true });
+  if (is.object(options) && is.defined(options.signal)) {
+    if (options.signal instanceof AbortSignal) {
+      this.options.abortSignal = options.signal;
+    } else {
+      throw is.invalidParameterError('signal', 'AbortSignal', options.signal);
+    }
+  }
   return this;
 };
 Object.setPrototypeOf(Sharp.prototype, stream.Duplex.prototype);
@@ -484,14 +510,22 @@ Object.setPrototypeOf(Sharp, stream.Duplex);
  * @returns {Sharp}
  */
 function clone () {
+  this._assertNotIncrementalStreamIn('clone');
   // Clone existing options
   const clone = this.constructor.call();
-  const { debuglog, queueListener, ...options } = this.options;
+  const {
+    debuglog, queueListener, abortSignal, streamOutput: _streamOutput, abortPipeline: _abortPipeline, ...options
+  } = this.options;
   clone.options = structuredClone(options);
   clone.options.debuglog = debuglog;
   clone.options.queueListener = queueListener;
+  if (abortSignal) {
+    clone.options.abortSignal = abortSignal;
+  }
   // Pass 'finish' event to clone for Stream-based input
   if (this._isStreamInput()) {
+    // Clones receive the complete input via the parent
+    clone.options.input.incremental = false;
     this._whenStreamInFinished(() => {
       // Clone inherits input data
       this._flattenBufferIn();
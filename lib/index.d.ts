@@ -85,7 +85,7 @@ declare namespace sharp {
     /** An Object containing the available interpolators and their proper values */
     const interpolators: Interpolators;
 
-    /** An EventEmitter that emits a change event when a task is either queued, waiting for libuv to provide a worker thread, complete */
+    /** An EventEmitter that emits a change event when a task is either queued, waiting for a worker thread, complete */
     const queue: NodeJS.EventEmitter;
 
     //#endregion
@@ -101,15 +101,38 @@ declare namespace sharp {
      */
     function cache(options?: boolean | CacheOptions): CacheResult;
 
+    /**
+     * Gets or, when options are provided, sets the limits of the result cache,
+     * which holds the output of tasks so an identical task returns it without processing.
+     * Only tasks with Buffer output are cached, identified by their options and the content of each input.
+     * The result cache is disabled by default. This method always returns cache statistics.
+     * @param options Object with the limits of memory and disk to use, and the directory in which to store results
+     * @throws {Error} Invalid parameters
+     * @returns The cache statistics.
+     */
+    function resultCache(options?: ResultCacheOptions): ResultCacheResult;
+
     /**
      * Gets or sets the number of threads libvips' should create to process each image.
      * The default value is the number of CPU cores. A value of 0 will reset to this default.
-     * The maximum number of images that can be processed in parallel is limited by libuv's UV_THREADPOOL_SIZE environment variable.
+     * The maximum number of images that can be processed in parallel is limited by the number of scheduler workers.
      * @param concurrency The new concurrency value.
      * @returns The current concurrency value.
      */
     function concurrency(concurrency?: number): number;
 
+    /**
+     * Gets or, when options are provided, sets the number of threads sharp uses to process images in parallel.
+     * These threads are owned by sharp rather than taken from the libuv thread pool.
+     * The default is the value of the UV_THREADPOOL_SIZE environment variable, or 4.
+     * Running tasks can share a memory budget, returning to the queue until the working set estimated from the input header fits.
+     * Identical tasks with Buffer output that are queued or running at the same time can share their result.
+     * @param options Object with optional `workers`, `memory` and `coalesce` attributes
+     * @throws {Error} Invalid parameters
+     * @returns The number of workers, the memory budget, whether tasks are coalesced and the number of tasks waiting for a worker in each priority lane or for memory.
+     */
+    function scheduler(options?: SchedulerOptions): SchedulerResult;
+
     /**
      * Provides access to internal task counters.
      * @returns Object containing task counters
@@ -170,6 +193,40 @@ declare namespace sharp {
      */
     function unblock(options: { operation: string[] }): void;
 
+    /**
+     * Process many inputs, typically small images such as icons and avatars,
+     * with the same operations and output options as a single task.
+     *
+     * @since 0.35.4
+     *
+     * @param inputs - as per the constructor.
+     * @param template - instance, without input, with the operations and output options to apply to every input.
+     * @param options - as per the constructor, applied to every input.
+     * @returns A promise that resolves with an array containing, for each input, an object containing either the Buffer data and an info object, or an error
+     * @throws {Error} Invalid parameters
+     */
+    function batch(
+        inputs: SharpInput[],
+        template: Sharp,
+        options?: SharpOptions,
+    ): Promise<Array<{ data: Buffer<ArrayBuffer>; info: OutputInfo; error?: undefined } | { data?: undefined; info?: undefined; error: Error }>>;
+
+    /**
+     * Prepare the operations and output options of a template once, for use with many inputs.
+     * Each input is queued as its own task, without parsing and validating the template again.
+     *
+     * @since 0.35.4
+     *
+     * @param template - instance, without input, with the operations and output options to apply to every input.
+     * @param options - as per the constructor, applied to every input.
+     * @returns A function that processes an input, optionally with different output dimensions, and resolves with the Buffer data and an info object
+     * @throws {Error} Invalid parameters
+     */
+    function prepare(
+        template: Sharp,
+        options?: SharpOptions,
+    ): (input: SharpInput, dimensions?: PreparedDimensions) => Promise<{ data: Buffer<ArrayBuffer>; info: OutputInfo }>;
+
     //#endregion
 
     const gravity: GravityEnum;
@@ -183,9 +240,11 @@ declare namespace sharp {
 
         /**
          * Remove alpha channel, if any. This is a no-op if the image does not have an alpha channel.
+         * @param options.ifOpaque remove alpha channels only when every pixel is fully opaque, before an operation that would premultiply (optional, default false).
          * @returns A sharp instance that can be used to chain operations
+         * @throws {Error} Invalid parameters
          */
-        removeAlpha(): Sharp;
+        removeAlpha(options?: RemoveAlphaOptions): Sharp;
 
         /**
          * Ensure alpha channel, if missing. The added alpha channel will be fully opaque. This is a no-op if the image already has an alpha channel.
@@ -683,9 +742,19 @@ declare namespace sharp {
         /**
          * Write output to a Uint8Array backed by a transferable ArrayBuffer. JPEG, PNG, WebP, AVIF, TIFF, GIF and RAW output are supported.
          * By default, the format will match the input image, except SVG input which becomes PNG output.
+         * @param options.transferable set to false to receive the memory allocated by libvips without copying (optional, default true)
          * @returns A promise that resolves with an object containing the Uint8Array data and an info object containing the output image format, size (bytes), width, height and channels
          */
-        toUint8Array(): Promise<{ data: Uint8Array; info: OutputInfo }>;
+        toUint8Array(options?: { transferable?: boolean | undefined }): Promise<{ data: Uint8Array; info: OutputInfo }>;
+
+        /**
+         * Write multiple outputs, for example several sizes and formats, from a single decode of the input.
+         * Each function receives a clone of this instance and returns it with the operations and output options for one output.
+         * @param outputs functions that configure each output.
+         * @returns A promise that resolves with an array containing, for each output, an object containing the Buffer data and an info object
+         * @throws {Error} Invalid parameters
+         */
+        fanOut(outputs: Array<(image: Sharp) => Sharp>): Promise<Array<{ data: Buffer<ArrayBuffer>; info: OutputInfo }>>;
 
         /**
          * Set output density (DPI) in EXIF metadata.
@@ -878,13 +947,49 @@ declare namespace sharp {
 
         /**
          * Set a timeout for processing, in seconds. Use a value of zero to continue processing indefinitely, the default behaviour.
-         * The clock starts when libvips opens an input image for processing. Time spent waiting for a libuv thread to become available is not included.
+         * The clock starts when libvips opens an input image for processing. Time spent waiting for a worker thread to become available is not included.
          * @param options Object with a `seconds` attribute between 0 and 3600 (number)
          * @throws {Error} Invalid options
          * @returns A sharp instance that can be used to chain operations
          */
         timeout(options: TimeoutOptions): Sharp;
 
+        /**
+         * Set how this task is scheduled relative to others waiting for a worker thread.
+         * Tasks with interactive priority always start before those with batch priority.
+         * Tasks with long latency are never allowed to occupy every worker thread.
+         * The number of libvips threads used to process this image can also be set.
+         * @param options Object with optional `priority` and `latency` attributes
+         * @throws {Error} Invalid parameters
+         * @returns A sharp instance that can be used to chain operations
+         */
+        schedule(options: ScheduleOptions): Sharp;
+
+        /**
+         * Pass encoded image data to the Readable side of a Stream as it is produced, rather than once encoding has finished.
+         * Encoding pauses when the consumer applies backpressure. TIFF, DZ, JPEG with gain map and raw output are always buffered.
+         * @param incremental (optional, default true)
+         * @throws {Error} Invalid parameters
+         * @returns A sharp instance that can be used to chain operations
+         */
+        incremental(incremental?: boolean): Sharp;
+
+        /**
+         * Record how long each stage of processing took, reported in milliseconds as the `timings` property of the output `info`.
+         * As libvips evaluates operations lazily, most of the time spent decoding and resizing is usually included in `output`.
+         * @param timings (optional, default true)
+         * @throws {Error} Invalid parameters
+         * @returns A sharp instance that can be used to chain operations
+         */
+        timings(timings?: boolean): Sharp;
+
+        /**
+         * Resolve the plan for processing the input with the current operations, reading only its header.
+         * Decisions that depend on pixel values, such as the bounding box found by `trim`, are not resolved.
+         * @returns A promise that resolves with the plan
+         */
+        explain(): Promise<PipelinePlan>;
+
         //#endregion
 
         //#region Resize functions
@@ -1011,13 +1116,27 @@ declare namespace sharp {
         unlimited?: boolean | undefined;
         /** Set this to false to use random access rather than sequential read. Some operations will do this automatically. */
         sequentialRead?: boolean | undefined;
+        /**
+         * For Stream-based input, set this to true to start decoding as soon as output is requested rather than waiting for the Writable side to finish.
+         * Formats that require random access are buffered by libvips. (optional, default false)
+         */
+        incremental?: boolean | undefined;
+        /**
+         * Stop processing when this signal is aborted. Tasks waiting for a worker thread are removed from the queue,
+         * running tasks are stopped at the next progress update.
+         */
+        signal?: AbortSignal | undefined;
         /** The DPI at which to render SVG and PDF images, in the range 1 to 100000. (optional, default 72) */
         density?: number | undefined;
         /** Should the embedded ICC profile, if any, be ignored. */
         ignoreIcc?: boolean | undefined;
+        /** Should conversion be skipped when the embedded ICC profile is equivalent to sRGB, or Display P3 for 16-bit input. (optional, default false) */
+        skipStandardIcc?: boolean | undefined;
+        /** When resizing, should an embedded HEIF/AVIF or EXIF thumbnail be used if at least as large as the output. (optional, default false) */
+        embeddedThumbnail?: boolean | undefined;
         /** Number of pages to extract for multi-page input (GIF, TIFF, PDF), use -1 for all pages */
         pages?: number | undefined;
-        /** Page number to start extracting from for multi-page input (GIF, TIFF, PDF), zero based. (optional, default 0) */
+        /** Page number to start extracting from for multi-page input (GIF, TIFF, PDF), zero based, or when resizing a pyramidal TIFF or JPEG 2000, the smallest with enough pixels. (optional, default 0) */
         page?: number | undefined;
         /** TIFF specific input options */
         tiff?: TiffInputOptions | undefined;
@@ -1054,6 +1173,17 @@ declare namespace sharp {
         files?: number | undefined;
         /** Is the maximum number of operations to cache (optional, default 100) */
         items?: number | undefined;
+        /** Is the maximum memory in MB to use for decoded composite and boolean overlays (optional, default 0) */
+        overlays?: number | undefined;
+    }
+
+    interface ResultCacheOptions {
+        /** Is the maximum memory in MB to use for results (optional, default 0) */
+        memory?: number | undefined;
+        /** Is the maximum disk space in MB to use for results (optional, default 0) */
+        disk?: number | undefined;
+        /** Is the directory in which to store results, required when `disk` is greater than zero */
+        directory?: string | undefined;
     }
 
     interface TimeoutOptions {
@@ -1061,11 +1191,57 @@ declare namespace sharp {
         seconds: number;
     }
 
+    interface ScheduleOptions {
+        /** Interactive tasks always start before batch tasks (optional, default 'interactive') */
+        priority?: 'interactive' | 'batch' | undefined;
+        /** Expected processing time, long tasks never occupy every worker thread (optional, default 'short') */
+        latency?: 'short' | 'long' | undefined;
+        /** Number of libvips threads for this image, overriding the process-wide concurrency, or 'auto' to choose from the output size (optional) */
+        concurrency?: number | 'auto' | undefined;
+    }
+
+    interface PreparedDimensions {
+        /** Output width in pixels, replacing that of the template (optional) */
+        width?: number | undefined;
+        /** Output height in pixels, replacing that of the template (optional) */
+        height?: number | undefined;
+    }
+
+    interface SchedulerOptions {
+        /** Number of threads used to process images in parallel, between 1 and 1024 */
+        workers?: number | undefined;
+        /** Memory budget in MB shared by all running tasks, zero for no limit (optional, default 0) */
+        memory?: number | undefined;
+        /** Share the result of identical tasks with Buffer output that are queued or running at the same time (optional, default false) */
+        coalesce?: boolean | undefined;
+    }
+
+    interface SchedulerResult {
+        /** Number of threads used to process images in parallel */
+        workers: number;
+        /** Memory budget in MB shared by all running tasks, zero for no limit */
+        memory: number;
+        /** Whether identical tasks share their result */
+        coalesce: boolean;
+        /** Number of tasks waiting for a worker thread, by priority, and tasks queued again waiting for memory */
+        queue: {
+            interactive: number;
+            batch: number;
+            memory: number;
+        };
+    }
+
     interface SharpCounters {
-        /** The number of tasks this module has queued waiting for libuv to provide a worker thread from its pool. */
+        /** The number of tasks this module has queued waiting for a worker thread. */
         queue: number;
         /** The number of resize tasks currently being processed. */
         process: number;
+        /** The total number of bytes of pixel data copied to memory by operations that require random access. */
+        materialised: number;
+        /** The largest increase in libvips tracked memory, in bytes, seen while processing a single task. */
+        memoryPeak: number;
+        /** The total number of tasks that shared the result of an identical task rather than being queued. */
+        coalesced: number;
     }
 
     interface Raw {
@@ -1146,7 +1322,7 @@ declare namespace sharp {
     }
 
     interface TiffInputOptions {
-        /** Sub Image File Directory to extract, defaults to main image. Use -1 for all subifds. */
+        /** Sub Image File Directory to extract, defaults to main image, or when resizing, the smallest with enough pixels. Use -1 for all subifds. */
         subifd?: number | undefined;
     }
 
@@ -1163,7 +1339,7 @@ declare namespace sharp {
     }
 
     interface OpenSlideInputOptions {
-        /** Level to extract from a multi-level input, zero based. (optional, default 0) */
+        /** Level to extract from a multi-level input, zero based, or when resizing, the smallest with enough pixels. (optional, default 0) */
         level?: number | undefined;
     }
 
@@ -1561,6 +1737,11 @@ declare namespace sharp {
         precision?: Precision | undefined;
     }
 
+    interface RemoveAlphaOptions {
+        /** remove alpha channels only when every pixel is fully opaque, before an operation that would premultiply. (optional, default false) */
+        ifOpaque?: boolean | undefined;
+    }
+
     interface FlattenOptions {
         /** background colour, parsed by the color module, defaults to black. (optional, default {r:0,g:0,b:0}) */
         background?: ColorLike | undefined;
@@ -1787,6 +1968,12 @@ declare namespace sharp {
         premultiplied: boolean;
         /** Indicates if the output image has an alpha channel */
         hasAlpha: boolean;
+        /** Only defined when using the skipStandardIcc constructor option, indicates if conversion of the embedded ICC profile was skipped */
+        iccSkipped?: boolean | undefined;
+        /** Only defined when using the embeddedThumbnail constructor option, indicates if the embedded thumbnail was used */
+        embeddedThumbnail?: boolean | undefined;
+        /** Only defined when using the concurrency option of schedule, the number of libvips threads used for output */
+        concurrency?: number | undefined;
         /** Only defined when using a crop strategy */
         cropOffsetLeft?: number | undefined;
         /** Only defined when using a crop strategy */
@@ -1804,6 +1991,74 @@ declare namespace sharp {
         pages?: number | undefined;
         /** Number of pixels high each page in a multi-page image will be. */
         pageHeight?: number | undefined;
+        /** Milliseconds spent in each stage of processing, only defined when using `timings` */
+        timings?: OutputTimings | undefined;
+        /** Memory used while processing, in bytes */
+        memory?: OutputMemory | undefined;
+    }
+
+    interface OutputMemory {
+        /** Change in libvips tracked memory, including that of any tasks processed at the same time */
+        delta: number;
+        /** High-water mark of libvips tracked memory above its value at the start, sampled between stages and, with timings, throughout output, including that of any tasks processed at the same time */
+        peak: number;
+        /** Bytes of pixel data copied to memory by operations that require random access */
+        materialised: number;
+    }
+
+    interface PipelinePlan {
+        /** Header of the input */
+        input: {
+            /** Name of decoder used to read the input */
+            format: keyof FormatEnum;
+            /** Number of pixels wide */
+            width: number;
+            /** Number of pixels high, including all pages */
+            height: number;
+            /** Number of bands */
+            channels: number;
+            /** Number of pages to process */
+            pages: number;
+            /** Whether the input can be decoded sequentially */
+            sequential: boolean;
+        };
+        /** Shrink applied while decoding */
+        shrinkOnLoad: {
+            /** Integer shrink factor, JPEG only */
+            shrink: number;
+            /** Scale factor, WebP, SVG and PDF only */
+            scale: number;
+            /** Number of pixels wide after decoding */
+            width: number;
+            /** Number of pixels high after decoding */
+            height: number;
+        };
+        /** Remaining resize after decoding */
+        resize: {
+            /** Horizontal shrink factor */
+            hshrink: number;
+            /** Vertical shrink factor */
+            vshrink: number;
+        };
+        /** Whether the alpha channel will be premultiplied, excluding one that removeAlpha ifOpaque may find to be fully opaque */
+        premultiply: boolean;
+        /** Operations that will run, in order */
+        operations: string[];
+        /** Operations that require random access to pixels, which decode the whole image into memory */
+        randomAccess: string[];
+    }
+
+    interface OutputTimings {
+        /** Waiting for a worker thread */
+        queue: number;
+        /** Opening the input and parsing its header */
+        open: number;
+        /** Building the pipeline, including operations that hold the whole image in memory */
+        pipeline: number;
+        /** Evaluating the remaining operations, encoding and writing the output */
+        output: number;
+        /** From queueing to completion */
+        total: number;
     }
 
     interface AvailableFormatInfo {
@@ -1971,6 +2226,14 @@ declare namespace sharp {
         memory: { current: number; high: number; max: number };
         files: { current: number; max: number };
         items: { current: number; max: number };
+        overlays: { current: number; max: number; items: number; hits: number; misses: number };
+    }
+
+    interface ResultCacheResult {
+        memory: { current: number; max: number; items: number };
+        disk: { current: number; max: number; items: number };
+        hits: number;
+        misses: number;
     }
 
     interface Interpolators {
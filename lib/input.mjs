@@ -26,7 +26,8 @@ const inputStreamParameters = [
   // Limits and error handling
   'failOn', 'limitInputPixels', 'limitInputChannels', 'unlimited',
   // Format-generic
-  'animated', 'autoOrient', 'density', 'ignoreIcc', 'page', 'pages', 'sequentialRead',
+  'animated', 'autoOrient', 'density', 'embeddedThumbnail', 'ignoreIcc', 'incremental', 'page', 'pages', 'sequentialRead',
+  'skipStandardIcc',
   // Format-specific
   'jp2', 'openSlide', 'pdf', 'raw', 'svg', 'tiff',
   // Deprecated
@@ -139,6 +140,22 @@ function _createInputDescriptor (input, inputOptions, containerOptions) {
         throw is.invalidParameterError('ignoreIcc', 'boolean', inputOptions.ignoreIcc);
       }
     }
+    // Skip conversion of embedded ICC profile equivalent to sRGB
+    if (is.defined(inputOptions.skipStandardIcc)) {
+      if (is.bool(inputOptions.skipStandardIcc)) {
+        inputDescriptor.skipStandardIcc = inputOptions.skipStandardIcc;
+      } else {
+        throw is.invalidParameterError('skipStandardIcc', 'boolean', inputOptions.skipStandardIcc);
+      }
+    }
+    // Use embedded thumbnail when large enough
+    if (is.defined(inputOptions.embeddedThumbnail)) {
+      if (is.bool(inputOptions.embeddedThumbnail)) {
+        inputDescriptor.embeddedThumbnail = inputOptions.embeddedThumbnail;
+      } else {
+        throw is.invalidParameterError('embeddedThumbnail', 'boolean', inputOptions.embeddedThumbnail);
+      }
+    }
     // limitInputPixels
     if (is.defined(inputOptions.limitInputPixels)) {
       if (is.bool(inputOptions.limitInputPixels)) {
@@ -177,6 +194,14 @@ function _createInputDescriptor (input, inputOptions, containerOptions) {
         throw is.invalidParameterError('sequentialRead', 'boolean', inputOptions.sequentialRead);
       }
     }
+    // incremental
+    if (is.defined(inputOptions.incremental)) {
+      if (is.bool(inputOptions.incremental)) {
+        inputDescriptor.incremental = inputOptions.incremental;
+      } else {
+        throw is.invalidParameterError('incremental', 'boolean', inputOptions.incremental);
+      }
+    }
     // Raw pixel input
     if (is.defined(inputOptions.raw)) {
       if (
@@ -529,7 +554,18 @@ function _createInputDescriptor (input, inputOptions, containerOptions) {
  * @param {Function} callback
  */
 function _write (chunk, _encoding, callback) {
-  if (Array.isArray(this.options.input.buffer)) {
+  if (this.options.input.streamIn) {
+    if (is.buffer(chunk)) {
+      if (sharp.streamInputWrite(this.options.input.streamIn, chunk)) {
+        callback();
+      } else {
+        // Wait until libvips has read enough of the data queued so far
+        this.options.input.streamInDrain = callback;
+      }
+    } else {
+      callback(new Error('Non-Buffer data on Writable Stream'));
+    }
+  } else if (Array.isArray(this.options.input.buffer)) {
     if (is.buffer(chunk)) {
       this.options.input.buffer.push(chunk);
       callback();
@@ -541,6 +577,71 @@ function _write (chunk, _encoding, callback) {
   }
 }
 
+/**
+ * Handle the end of the Writable Stream.
+ * @private
+ * @param {Function} callback
+ */
+function _final (callback) {
+  if (this.options.input.streamIn) {
+    sharp.streamInputEnd(this.options.input.streamIn, false);
+  }
+  callback();
+}
+
+/**
+ * Handle destruction of the Stream, aborting any queued or running task.
+ * @private
+ * @param {Error} err
+ * @param {Function} callback
+ */
+function _destroy (err, callback) {
+  if (this.options.abortPipeline) {
+    this.options.abortPipeline();
+  }
+  if (this.options.input.streamIn) {
+    sharp.streamInputEnd(this.options.input.streamIn, true);
+  }
+  if (this.options.streamOutput) {
+    sharp.streamOutputDestroy(this.options.streamOutput);
+  }
+  callback(err);
+}
+
+/**
+ * Switch Stream-based input to incremental decoding, when requested and
+ * the Writable side has not yet ended, passing any chunks received so far
+ * and those yet to arrive directly to libvips.
+ * @private
+ */
+function _beginIncrementalStreamIn () {
+  if (this._isStreamInput() && this.options.input.incremental && !this.writableEnded) {
+    const streamIn = sharp.streamInputCreate(this.writableHighWaterMark, () => {
+      const callback = this.options.input.streamInDrain;
+      if (callback) {
+        delete this.options.input.streamInDrain;
+        callback();
+      }
+    });
+    for (const chunk of this.options.input.buffer) {
+      sharp.streamInputWrite(streamIn, chunk);
+    }
+    delete this.options.input.buffer;
+    this.options.input.streamIn = streamIn;
+  }
+}
+
+/**
+ * Ensure incremental Stream-based input has not yet started.
+ * @private
+ * @param {string} method
+ */
+function _assertNotIncrementalStreamIn (method) {
+  if (this.options.input.streamIn) {
+    throw new Error(`Cannot call ${method}() once incremental Stream-based input has started`);
+  }
+}
+
 /**
  * Flattens the array of chunks accumulated in input.buffer.
  * @private
@@ -648,6 +749,7 @@ function _whenStreamInFinished (fn) {
  * @returns {Promise<Object>|Sharp}
  */
 function metadata (callback) {
+  this._assertNotIncrementalStreamIn('metadata');
   const stack = Error();
   if (is.fn(callback)) {
     if (this._isStreamInput()) {
@@ -745,6 +847,7 @@ function metadata (callback) {
  * @returns {Promise<Object>}
  */
 function stats (callback) {
+  this._assertNotIncrementalStreamIn('stats');
   const stack = Error();
   if (is.fn(callback)) {
     if (this._isStreamInput()) {
@@ -807,6 +910,10 @@ export default (Sharp) => {
     _inputOptionsFromObject,
     _createInputDescriptor,
     _write,
+    _final,
+    _destroy,
+    _beginIncrementalStreamIn,
+    _assertNotIncrementalStreamIn,
     _flattenBufferIn,
     _isStreamInput,
     _whenStreamInFinished,
@@ -67,6 +67,7 @@ const bitdepthFromColourCount = (colours) => 1 << 32 - Math.clz32(Math.ceil(Math
  * When using the attention crop strategy also contains `attentionX` and `attentionY`, the focal point of the cropped region.
  * Animated output will also contain `pageHeight` and `pages`.
  * May also contain `textAutofitDpi` (dpi the font was rendered at) if image was created from text.
+ * Also contains `memory`, the change (`delta`) and high-water mark (`peak`) of libvips tracked memory in bytes while processing, sampled between stages and, when `timings` are requested, throughout output, and the bytes `materialised` to hold images in memory.
  * @returns {Promise<Object>} - when no callback is provided
  * @throws {Error} Invalid parameters
  */
@@ -112,6 +113,7 @@ function toFile (fileOut, callback) {
  * When using a crop strategy also contains `cropOffsetLeft` and `cropOffsetTop`.
  * Animated output will also contain `pageHeight` and `pages`.
  * May also contain `textAutofitDpi` (dpi the font was rendered at) if image was created from text.
+ * Also contains `memory`, the change (`delta`) and high-water mark (`peak`) of libvips tracked memory in bytes while processing, sampled between stages and, when `timings` are requested, throughout output, and the bytes `materialised` to hold images in memory.
  *
  * The underlying `ArrayBuffer` may be marked as non-transferable by some JavaScript runtimes.
  * Use {@link #touint8array toUint8Array} for a guaranteed transferable `ArrayBuffer`.
@@ -175,6 +177,9 @@ function toBuffer (options, callback) {
  * - `data` is the output image as a `Uint8Array` backed by a transferable `ArrayBuffer`.
  * - `info` contains properties relating to the output image such as `width` and `height`.
  *
+ * Set `transferable` to `false` to avoid copying the output on the main thread,
+ * useful for large raw pixel data, at the cost of an `ArrayBuffer` that cannot be transferred.
+ *
  * @since v0.35.0
  *
  * @example
@@ -186,15 +191,139 @@ function toBuffer (options, callback) {
  *   .toUint8Array();
  * const base64String = data.toBase64();
  *
+ * @example
+ * // Large raw pixel data without copying
+ * const { data, info } = await sharp(input)
+ *   .raw()
+ *   .toUint8Array({ transferable: false });
+ *
+ * @param {Object} [options]
+ * @param {boolean} [options.transferable=true] - set to `false` to receive the memory allocated by libvips without copying.
  * @returns {Promise<{ data: Uint8Array, info: Object }>}
  */
-function toUint8Array () {
+function toUint8Array (options) {
+  this.options.typedArrayTransferable = true;
+  if (is.object(options) && is.defined(options.transferable)) {
+    if (is.bool(options.transferable)) {
+      this.options.typedArrayTransferable = options.transferable;
+    } else {
+      throw is.invalidParameterError('transferable', 'boolean', options.transferable);
+    }
+  }
   this.options.resolveWithObject = true;
   this.options.typedArrayOut = true;
   const stack = Error();
   return this._pipeline(null, stack);
 }
 
+/**
+ * Write multiple outputs, for example several sizes and formats, from a single decode of the input.
+ *
+ * Each function receives a {@link /api-constructor/#clone clone} of this instance
+ * and returns it with the operations and output options for one output.
+ *
+ * The input is decoded once, using shrink-on-load no further than the largest output allows,
+ * and held in memory while each output is processed in turn by the same worker thread.
+ *
+ * Resolves with an `Array` containing, for each output in order, an `Object` with:
+ * - `data` is the output image as a `Buffer`.
+ * - `info` contains properties relating to the output image such as `width` and `height`.
+ *
+ * @since 0.35.4
+ *
+ * @example
+ * const [thumbnail, preview] = await sharp(input).fanOut([
+ *   (image) => image.resize(320).webp(),
+ *   (image) => image.resize(1280).jpeg({ quality: 80 })
+ * ]);
+ * // thumbnail.data is a WebP Buffer, 320 pixels wide
+ * // preview.data is a JPEG Buffer, 1280 pixels wide
+ *
+ * @param {Array<function(Sharp): Sharp>} outputs - functions that configure each output.
+ * @returns {Promise<Array<{ data: Buffer, info: Object }>>}
+ * @throws {Error} Invalid parameters
+ */
+function fanOut (outputs) {
+  if (!Array.isArray(outputs) || outputs.length === 0 || !outputs.every(is.fn)) {
+    throw is.invalidParameterError('outputs', 'non-empty Array of functions', outputs);
+  }
+  this._assertNotIncrementalStreamIn('fanOut');
+  // Outputs share the input of this instance rather than receive a copy of it
+  const { input } = this.options;
+  this.options.input = {};
+  let branches;
+  try {
+    branches = outputs.map((output) => output(this.clone()));
+  } finally {
+    this.options.input = input;
+  }
+  if (!branches.every((branch) => branch instanceof this.constructor)) {
+    throw is.invalidParameterError('outputs', 'Array of functions returning a sharp instance', outputs);
+  }
+  this.options.fanOut = branches.map((branch) => ({ ...branch.options, input }));
+  const stack = Error();
+  return new Promise((resolve, reject) => {
+    this._pipeline((err, results) => {
+      delete this.options.fanOut;
+      if (err) {
+        reject(err);
+      } else {
+        resolve(results);
+      }
+    }, stack);
+  });
+}
+
+/**
+ * Resolve the plan for processing the input with the current operations, without processing it.
+ *
+ * Only the header of the input is read, so this is much cheaper than producing the output,
+ * and can be used to compare option combinations, e.g. to find those that allow shrink-on-load
+ * or avoid decoding the whole image into memory.
+ *
+ * Resolves with an `Object` containing:
+ * - `input` describes the header of the input: `format`, `width`, `height`, `channels`, `pages`
+ *   and whether it can be decoded `sequential`ly.
+ * - `shrinkOnLoad` contains the integer `shrink` factor (JPEG) or `scale` (WebP, SVG, PDF) used when decoding,
+ *   and the `width` and `height` of the decoded image, which is any embedded thumbnail that will be used.
+ * - `resize` contains the `hshrink` and `vshrink` factors of the remaining resize.
+ * - `premultiply` is `true` when the alpha channel will be premultiplied,
+ *   excluding one that `removeAlpha({ ifOpaque: true })` listed in `operations` may find to be fully opaque.
+ * - `operations` lists the operations that will run, in order.
+ * - `randomAccess` lists the operations that require random access to pixels,
+ *   which decode the whole image into memory.
+ *
+ * Decisions that depend on pixel values, such as the bounding box found by `trim`, are not resolved.
+ *
+ * @since 0.35.4
+ *
+ * @example
+ * const plan = await sharp('input.jpg')
+ *   .resize(320)
+ *   .rotate(90)
+ *   .explain();
+ * // plan.shrinkOnLoad.shrink is 4
+ * // plan.operations is ['resize', 'rotate']
+ * // plan.randomAccess is ['rotate']
+ *
+ * @returns {Promise<Object>}
+ */
+function explain () {
+  this._assertNotIncrementalStreamIn('explain');
+  this.options.explain = true;
+  const stack = Error();
+  return new Promise((resolve, reject) => {
+    this._pipeline((err, plan) => {
+      this.options.explain = false;
+      if (err) {
+        reject(err);
+      } else {
+        resolve(plan);
+      }
+    }, stack);
+  });
+}
+
 /**
  * Set output density (DPI) in EXIF metadata.
  *
@@ -339,6 +468,9 @@ function keepIccProfile () {
  * This can either be an absolute filesystem path or
  * built-in profile name (`srgb`, `p3`, `cmyk`).
  *
+ * When the profile is equivalent to that of the image, e.g. both are sRGB,
+ * it is attached without transforming pixel values.
+ *
  * @since 0.33.0
  *
  * @example
@@ -1565,7 +1697,7 @@ function tile (options) {
  * Use a value of zero to continue processing indefinitely, the default behaviour.
  *
  * The clock starts when libvips opens an input image for processing.
- * Time spent waiting for a libuv thread to become available is not included.
+ * Time spent waiting for a worker thread to become available is not included.
  *
  * @example
  * // Ensure processing takes no longer than 3 seconds
@@ -1596,6 +1728,144 @@ function timeout (options) {
   return this;
 }
 
+/**
+ * Set how this task is scheduled relative to others waiting for a worker thread.
+ *
+ * Tasks with `interactive` priority, the default, always start before those with `batch` priority,
+ * so that latency-sensitive work such as responding to a request is not held behind bulk work.
+ *
+ * Tasks with `long` latency, e.g. very large images, are never allowed to occupy every thread,
+ * leaving at least one free for `short` tasks when there is more than one thread.
+ *
+ * See {@link /api-utility/#scheduler scheduler} to set the number of threads.
+ *
+ * The number of _libvips_ threads used to process this image can be set,
+ * overriding the process-wide {@link /api-utility/#concurrency concurrency}.
+ * Use `auto` to allow one thread per megapixel of output, sharing the
+ * process-wide concurrency between the tasks currently being processed.
+ * The number of threads used for output is reported as the `concurrency` property of the output `info`.
+ *
+ * @example
+ * // Generate thumbnails in the background without delaying interactive requests
+ * const data = await sharp(input)
+ *   .resize(200)
+ *   .schedule({ priority: 'batch' })
+ *   .toBuffer();
+ * @example
+ * // Give a large image more threads than the thumbnails processed alongside it
+ * const data = await sharp(largeTiff)
+ *   .schedule({ latency: 'long', concurrency: 8 })
+ *   .toBuffer();
+ *
+ * @since 0.35.4
+ *
+ * @param {Object} options
+ * @param {string} [options.priority='interactive'] - one of `interactive` or `batch`.
+ * @param {string} [options.latency='short'] - expected processing time, one of `short` or `long`.
+ * @param {number|string} [options.concurrency] - number of _libvips_ threads for this image, between 1 and 1024, or `auto`.
+ * @returns {Sharp}
+ * @throws {Error} Invalid parameters
+ */
+function schedule (options) {
+  if (!is.plainObject(options)) {
+    throw is.invalidParameterError('options', 'object', options);
+  }
+  if (is.defined(options.priority)) {
+    if (is.string(options.priority) && is.inArray(options.priority, ['interactive', 'batch'])) {
+      this.options.schedulePriority = options.priority;
+    } else {
+      throw is.invalidParameterError('priority', 'one of: interactive, batch', options.priority);
+    }
+  }
+  if (is.defined(options.latency)) {
+    if (is.string(options.latency) && is.inArray(options.latency, ['short', 'long'])) {
+      this.options.scheduleLatency = options.latency;
+    } else {
+      throw is.invalidParameterError('latency', 'one of: short, long', options.latency);
+    }
+  }
+  if (is.defined(options.concurrency)) {
+    if (is.integer(options.concurrency) && is.inRange(options.concurrency, 1, 1024)) {
+      this.options.scheduleConcurrency = options.concurrency;
+    } else if (options.concurrency === 'auto') {
+      this.options.scheduleConcurrency = -1;
+    } else {
+      throw is.invalidParameterError('concurrency', 'integer between 1 and 1024, or auto', options.concurrency);
+    }
+  }
+  return this;
+}
+
+/**
+ * Pass encoded image data to the Readable side of a Stream as it is produced,
+ * rather than once encoding has finished.
+ *
+ * Applies to Stream-based output only.
+ * Encoding pauses when the consumer applies backpressure and
+ * stops with an error when the Stream is destroyed.
+ * The `info` event is emitted after all data has been pushed.
+ *
+ * TIFF, DZ, JPEG with gain map and raw output are always buffered.
+ *
+ * @example
+ * // Start sending a large JPEG before encoding has finished
+ * readableStream
+ *   .pipe(sharp({ incremental: true }).jpeg().incremental())
+ *   .pipe(response);
+ *
+ * @since 0.35.4
+ *
+ * @param {boolean} [incremental=true]
+ * @returns {Sharp}
+ * @throws {Error} Invalid parameters
+ */
+function incremental (incremental) {
+  if (is.defined(incremental) && !is.bool(incremental)) {
+    throw is.invalidParameterError('incremental', 'boolean', incremental);
+  }
+  this.options.incrementalOut = incremental !== false;
+  return this;
+}
+
+/**
+ * Record how long each stage of processing took,
+ * reported in milliseconds as the `timings` property of the output `info`.
+ *
+ * - `queue` is the time spent waiting for a worker thread.
+ * - `open` is the time spent opening the input and parsing its header.
+ * - `pipeline` is the time spent building the pipeline of operations,
+ *   including any operations that require the whole image to be held in memory,
+ *   e.g. rotation by 90 degrees, trim or normalise.
+ * - `output` is the time spent evaluating the remaining operations, which run
+ *   while pixels are pulled through the pipeline, plus encoding and writing the output.
+ * - `total` is the time from queueing to completion.
+ *
+ * As libvips evaluates operations lazily, most of the time spent decoding the input
+ * and resizing is usually included in `output`.
+ *
+ * When the output is taken from the result cache, all stages other than `queue` take no time.
+ *
+ * @example
+ * const { info } = await sharp(input)
+ *   .resize(320)
+ *   .timings()
+ *   .toBuffer({ resolveWithObject: true });
+ * // info.timings is { queue: 0.1, open: 0.4, pipeline: 0.2, output: 12.3, total: 13 }
+ *
+ * @since 0.35.4
+ *
+ * @param {boolean} [timings=true]
+ * @returns {Sharp}
+ * @throws {Error} Invalid parameters
+ */
+function timings (timings) {
+  if (is.defined(timings) && !is.bool(timings)) {
+    throw is.invalidParameterError('timings', 'boolean', timings);
+  }
+  this.options.timings = timings !== false;
+  return this;
+}
+
 /**
  * Update the output format unless options.force is false,
  * in which case revert to input format.
@@ -1636,6 +1906,34 @@ function _read () {
     this.options.streamOut = true;
     const stack = Error();
     this._pipeline(undefined, stack);
+  } else if (this.options.streamOutput) {
+    sharp.streamOutputResume(this.options.streamOutput);
+  }
+}
+
+/**
+ * Queue a task for the C++ image processing pipeline,
+ * aborting it when the AbortSignal provided to the constructor is aborted.
+ * @private
+ * @param {Object} options
+ * @param {Function} callback
+ */
+function _queuePipeline (options, callback) {
+  const { abortSignal } = this.options;
+  const abort = sharp.pipeline(options, (...args) => {
+    abortSignal?.removeEventListener('abort', abort);
+    if (this.options.abortPipeline === abort) {
+      delete this.options.abortPipeline;
+    }
+    callback(...args);
+  });
+  this.options.abortPipeline = abort;
+  if (abortSignal) {
+    if (abortSignal.aborted) {
+      abort();
+    } else {
+      abortSignal.addEventListener('abort', abort, { once: true });
+    }
   }
 }
 
@@ -1645,13 +1943,14 @@ function _read () {
  * @private
  */
 function _pipeline (callback, stack) {
+  this._beginIncrementalStreamIn();
   if (typeof callback === 'function') {
     // output=file/buffer
     if (this._isStreamInput()) {
       // output=file/buffer, input=stream
       this._whenStreamInFinished(() => {
         this._flattenBufferIn();
-        sharp.pipeline(this.options, (err, data, info) => {
+        this._queuePipeline(this.options, (err, data, info) => {
           if (err) {
             callback(is.nativeError(err, stack));
           } else {
@@ -1661,7 +1960,7 @@ function _pipeline (callback, stack) {
       });
     } else {
       // output=file/buffer, input=file/buffer
-      sharp.pipeline(this.options, (err, data, info) => {
+      this._queuePipeline(this.options, (err, data, info) => {
         if (err) {
           callback(is.nativeError(err, stack));
         } else {
@@ -1672,16 +1971,21 @@ function _pipeline (callback, stack) {
     return this;
   } else if (this.options.streamOut) {
     // output=stream
+    if (this.options.incrementalOut) {
+      this.options.streamOutput = sharp.streamOutputCreate((chunk) => this.push(chunk));
+    }
     if (this._isStreamInput()) {
       // output=stream, input=stream
       this._whenStreamInFinished(() => {
         this._flattenBufferIn();
-        sharp.pipeline(this.options, (err, data, info) => {
+        this._queuePipeline(this.options, (err, data, info) => {
           if (err) {
             this.emit('error', is.nativeError(err, stack));
           } else {
             this.emit('info', info);
-            this.push(data);
+            if (data) {
+              this.push(data);
+            }
           }
           this.push(null);
           this.on('end', () => this.emit('close'));
@@ -1689,12 +1993,14 @@ function _pipeline (callback, stack) {
       });
     } else {
       // output=stream, input=file/buffer
-      sharp.pipeline(this.options, (err, data, info) => {
+      this._queuePipeline(this.options, (err, data, info) => {
         if (err) {
           this.emit('error', is.nativeError(err, stack));
         } else {
           this.emit('info', info);
-          this.push(data);
+          if (data) {
+            this.push(data);
+          }
         }
         this.push(null);
         this.on('end', () => this.emit('close'));
@@ -1708,7 +2014,7 @@ function _pipeline (callback, stack) {
       return new Promise((resolve, reject) => {
         this._whenStreamInFinished(() => {
           this._flattenBufferIn();
-          sharp.pipeline(this.options, (err, data, info) => {
+          this._queuePipeline(this.options, (err, data, info) => {
             if (err) {
               reject(is.nativeError(err, stack));
             } else {
@@ -1724,7 +2030,7 @@ function _pipeline (callback, stack) {
     } else {
       // output=promise, input=file/buffer
       return new Promise((resolve, reject) => {
-        sharp.pipeline(this.options, (err, data, info) => {
+        this._queuePipeline(this.options, (err, data, info) => {
           if (err) {
             reject(is.nativeError(err, stack));
           } else {
@@ -1751,6 +2057,8 @@ export default (Sharp) => {
     toFile,
     toBuffer,
     toUint8Array,
+    fanOut,
+    explain,
     withDensity,
     keepExif,
     withExif,
@@ -1776,10 +2084,14 @@ export default (Sharp) => {
     raw,
     tile,
     timeout,
+    schedule,
+    incremental,
+    timings,
     // Private
     _updateFormatOut,
     _setBooleanOption,
     _read,
+    _queuePipeline,
     _pipeline
   });
 };
@@ -92,41 +92,98 @@ if (versions.heif && format.heif) {
  * This method always returns cache statistics,
  * useful for determining how much working memory is required for a particular task.
  *
+ * The `overlays` cache, disabled by default, holds the decoded images used by
+ * {@link /api-composite/#composite composite} and {@link /api-operation/#boolean boolean},
+ * ready for use, so the same overlay, e.g. a watermark, is decoded only once.
+ * Entries are identified by the content of a Buffer or the path, size and modification time of a file,
+ * and the least recently used are removed first.
+ *
  * @example
  * const stats = sharp.cache();
  * @example
  * sharp.cache( { items: 200 } );
  * sharp.cache( { files: 0 } );
  * sharp.cache(false);
+ * @example
+ * // Decode each watermark once
+ * sharp.cache({ overlays: 20 });
  *
  * @param {Object|boolean} [options=true] - Object with the following attributes, or boolean where true uses default cache settings and false removes all caching
  * @param {number} [options.memory=50] - is the maximum memory in MB to use for this cache
  * @param {number} [options.files=20] - is the maximum number of files to hold open
  * @param {number} [options.items=100] - is the maximum number of operations to cache
+ * @param {number} [options.overlays=0] - is the maximum memory in MB to use for decoded overlays
  * @returns {Object}
  */
 function cache (options) {
   if (is.bool(options)) {
     if (options) {
-      // Default cache settings of 50MB, 20 files, 100 items
-      return sharp.cache(50, 20, 100);
+      // Default cache settings of 50MB, 20 files, 100 items, no overlays
+      return sharp.cache(50, 20, 100, 0);
     } else {
-      return sharp.cache(0, 0, 0);
+      return sharp.cache(0, 0, 0, 0);
     }
   } else if (is.object(options)) {
-    for (const property of ['memory', 'files', 'items']) {
+    for (const property of ['memory', 'files', 'items', 'overlays']) {
       const value = options[property];
       if (is.defined(value) && !(is.integer(value) && value >= 0)) {
         throw is.invalidParameterError(property, 'a positive integer', value);
       }
     }
-    return sharp.cache(options.memory, options.files, options.items);
+    return sharp.cache(options.memory, options.files, options.items, options.overlays);
   } else {
     return sharp.cache();
   }
 }
 cache(true);
 
+/**
+ * Gets or, when options are provided, sets the limits of the result cache,
+ * which holds the output of tasks so an identical task returns it without decoding, processing or encoding.
+ *
+ * Only tasks with Buffer output are cached, identified by their operations and output options
+ * plus the content of each input: the SHA-256 digest of a Buffer or the path, size and modification time of a file.
+ * Tasks with Stream input that is processed incrementally, or with created or text input, are never cached.
+ *
+ * Results are held in memory, and optionally in files within a directory, which are reused by
+ * later processes that set the same directory. The least recently used results are removed first.
+ *
+ * The result cache is disabled by default.
+ * This method always returns cache statistics.
+ *
+ * @since 0.35.4
+ *
+ * @example
+ * sharp.resultCache({ memory: 200, disk: 2000, directory: '/var/cache/images' });
+ * @example
+ * const { hits, misses } = sharp.resultCache();
+ *
+ * @param {Object} [options]
+ * @param {number} [options.memory=0] - is the maximum memory in MB to use for results
+ * @param {number} [options.disk=0] - is the maximum disk space in MB to use for results
+ * @param {string} [options.directory] - is the directory in which to store results, required when `disk` is greater than zero
+ * @returns {Object}
+ * @throws {Error} Invalid parameters
+ */
+function resultCache (options) {
+  if (is.defined(options)) {
+    if (!is.object(options)) {
+      throw is.invalidParameterError('options', 'object', options);
+    }
+    for (const property of ['memory', 'disk']) {
+      const value = options[property];
+      if (is.defined(value) && !(is.integer(value) && value >= 0)) {
+        throw is.invalidParameterError(property, 'a positive integer', value);
+      }
+    }
+    if (options.disk > 0 && !(is.string(options.directory) && options.directory.length > 0)) {
+      throw is.invalidParameterError('directory', 'non-empty string', options.directory);
+    }
+    return sharp.resultCache(options.memory, options.disk, options.directory);
+  }
+  return sharp.resultCache();
+}
+
 /**
  * Gets or, when a concurrency is provided, sets
  * the maximum number of threads _libvips_ should use to process _each image_.
@@ -141,6 +198,8 @@ cache(true);
  *
  * A value of `0` will reset this to the number of CPU cores.
  *
+ * Use {@link /api-output/#schedule schedule} to override this for a single image.
+ *
  * Some image format libraries spawn additional threads,
  * e.g. libaom manages its own 4 threads when encoding AVIF images,
  * and these are independent of the value set here.
@@ -169,9 +228,92 @@ if (!process.env.MALLOC_ARENA_MAX && detectLibc.familySync() === detectLibc.GLIB
   sharp.concurrency(availableParallelism());
 }
 
+/**
+ * Gets or, when options are provided, sets
+ * the number of threads sharp uses to process images in parallel.
+ *
+ * These threads are owned by sharp rather than taken from the _libuv_ thread pool,
+ * so image processing does not delay filesystem, DNS and other asynchronous work.
+ * Each thread processes one image at a time, using up to `concurrency` _libvips_ threads.
+ *
+ * Tasks with `interactive` priority always start before those with `batch` priority.
+ * When there is more than one thread, at least one is kept free of tasks with `long` latency.
+ * See {@link /api-output/#schedule schedule}.
+ *
+ * The default number of threads is the value of the `UV_THREADPOOL_SIZE` environment variable, or 4.
+ * Reducing the number of threads takes effect as each thread becomes idle.
+ *
+ * A memory budget can be shared by all running tasks.
+ * Once a task has read the header of its input, and chosen any shrink-on-load, it estimates its working set from the
+ * dimensions, channels and pixel format, assuming the whole image will be held in memory
+ * when it cannot be decoded sequentially or an operation such as rotation requires random access.
+ * When its estimate does not fit within the budget, the task returns to the queue, freeing its thread,
+ * and starts again once the estimate fits.
+ * A task is always allowed to run when no other task holds memory, even when its estimate exceeds the budget.
+ *
+ * Identical tasks can be coalesced, so a task with Buffer output that has the same input and operations
+ * as one already queued or running shares its result rather than being queued.
+ * Each caller receives its own `info` and a Buffer that shares the memory of the others, so must not modify it.
+ * Buffer inputs are identical when they are the same Buffer object, which must not be modified until the task completes.
+ * Tasks with file or Stream output, or with a `signal` constructor option, are never coalesced.
+ *
+ * @since 0.35.4
+ *
+ * @example
+ * const { workers, memory, queue } = sharp.scheduler();
+ * // { workers: 4, memory: 0, coalesce: false, queue: { interactive: 0, batch: 12, memory: 0 } }
+ * @example
+ * sharp.scheduler({ workers: os.availableParallelism() });
+ * @example
+ * // Limit the estimated memory of images being processed at the same time to 2GB
+ * sharp.scheduler({ memory: 2048 });
+ * @example
+ * // Process concurrent requests for the same thumbnail once
+ * sharp.scheduler({ coalesce: true });
+ *
+ * @param {Object} [options]
+ * @param {number} [options.workers] - number of threads, between 1 and 1024.
+ * @param {number} [options.memory] - memory budget in MB shared by all running tasks, or zero for no limit.
+ * @param {boolean} [options.coalesce] - share the result of identical tasks that are queued or running at the same time.
+ * @returns {Object} with `workers`, `memory`, `coalesce` and `queue`, the number of tasks waiting for a thread in each priority lane and waiting for memory.
+ * @throws {Error} Invalid parameters
+ */
+function scheduler (options) {
+  let workers = null;
+  let memory = null;
+  let coalesce = null;
+  if (is.defined(options)) {
+    if (!is.object(options)) {
+      throw is.invalidParameterError('options', 'object', options);
+    }
+    if (is.defined(options.workers)) {
+      if (is.integer(options.workers) && is.inRange(options.workers, 1, 1024)) {
+        workers = options.workers;
+      } else {
+        throw is.invalidParameterError('workers', 'integer between 1 and 1024', options.workers);
+      }
+    }
+    if (is.defined(options.memory)) {
+      if (is.integer(options.memory) && is.inRange(options.memory, 0, 4194304)) {
+        memory = options.memory;
+      } else {
+        throw is.invalidParameterError('memory', 'integer between 0 and 4194304', options.memory);
+      }
+    }
+    if (is.defined(options.coalesce)) {
+      if (is.bool(options.coalesce)) {
+        coalesce = options.coalesce;
+      } else {
+        throw is.invalidParameterError('coalesce', 'boolean', options.coalesce);
+      }
+    }
+  }
+  return sharp.scheduler(workers, memory, coalesce);
+}
+
 /**
  * An EventEmitter that emits a `change` event when a task is either:
- * - queued, waiting for _libuv_ to provide a worker thread
+ * - queued, waiting for a worker thread
  * - complete
  * @member
  * @example
@@ -183,11 +325,16 @@ const queue = new events.EventEmitter();
 
 /**
  * Provides access to internal task counters.
- * - queue is the number of tasks this module has queued waiting for _libuv_ to provide a worker thread from its pool.
+ * - queue is the number of tasks this module has queued waiting for a worker thread.
  * - process is the number of resize tasks currently being processed.
+ * - materialised is the total number of bytes of pixel data copied to memory by operations that require random access.
+ * - memoryPeak is the largest increase in libvips tracked memory, in bytes, seen while processing a single task.
+ * - coalesced is the total number of tasks that shared the result of an identical task rather than being queued.
+ *
+ * Tracked memory is shared by all tasks, so per-task values include memory used by any tasks processed at the same time.
  *
  * @example
- * const counters = sharp.counters(); // { queue: 2, process: 4 }
+ * const counters = sharp.counters(); // { queue: 2, process: 4, materialised: 73400320, memoryPeak: 52428800, coalesced: 0 }
  *
  * @returns {Object}
  */
@@ -282,6 +429,123 @@ function unblock (options) {
   }
 }
 
+/**
+ * Process many inputs, typically small images such as icons and avatars,
+ * with the same operations and output options as a single task.
+ *
+ * Each input is processed in turn by the same worker thread, avoiding the
+ * per-image cost of parsing options, queueing a task and calling back to JavaScript.
+ *
+ * Resolves with an `Array` containing, for each input in order, an `Object` with either:
+ * - `data` is the output image as a `Buffer` and `info` contains properties relating to the output image, or
+ * - `error` is an `Error` describing why this input could not be processed.
+ *
+ * @since 0.35.4
+ *
+ * @example
+ * const results = await sharp.batch(avatars, sharp().resize(64, 64).webp());
+ * for (const { data, info, error } of results) {
+ *   // data is a 64x64 WebP Buffer, unless error is set
+ * }
+ *
+ * @param {Array<(Buffer|ArrayBuffer|Uint8Array|Uint8ClampedArray|Int8Array|Uint16Array|Int16Array|Uint32Array|Int32Array|Float32Array|Float64Array|string)>} inputs - as per the constructor.
+ * @param {Sharp} template - instance, without input, with the operations and output options to apply to every input.
+ * @param {Object} [options] - as per the constructor, applied to every input.
+ * @returns {Promise<Array<{ data: Buffer, info: Object } | { error: Error }>>}
+ * @throws {Error} Invalid parameters
+ */
+function batch (inputs, template, options) {
+  if (!Array.isArray(inputs) || inputs.length === 0 || inputs.some(Array.isArray)) {
+    throw is.invalidParameterError('inputs', 'non-empty Array of images', inputs);
+  }
+  if (!(template instanceof this)) {
+    throw is.invalidParameterError('template', 'sharp instance', template);
+  }
+  const descriptors = inputs.map((input) => template._createInputDescriptor(input, options));
+  const stack = Error();
+  return new Promise((resolve, reject) => {
+    template._queuePipeline({ ...template.options, input: descriptors[0], batch: descriptors }, (err, results) => {
+      if (err) {
+        reject(is.nativeError(err, stack));
+      } else {
+        resolve(results);
+      }
+    });
+  });
+}
+
+/**
+ * Prepare the operations and output options of a template once, for use with many inputs.
+ *
+ * Returns a function that processes a single input, queueing it as its own task,
+ * without the per-image cost of parsing and validating the operations and output options again.
+ * The output width and height can optionally be changed for each input.
+ *
+ * The returned function resolves with an `Object` containing
+ * `data`, the output image as a `Buffer`, and `info`, containing properties relating to the output image.
+ *
+ * Changes made to the template after it is prepared have no effect.
+ *
+ * @since 0.35.4
+ *
+ * @example
+ * const thumbnail = sharp.prepare(sharp().resize(320, 240).webp());
+ * const { data, info } = await thumbnail(input);
+ * @example
+ * // Change the output dimensions for this input
+ * const { data, info } = await thumbnail(input, { width: 640, height: 480 });
+ *
+ * @param {Sharp} template - instance, without input, with the operations and output options to apply to every input.
+ * @param {Object} [options] - as per the constructor, applied to every input.
+ * @returns {function((Buffer|ArrayBuffer|Uint8Array|Uint8ClampedArray|Int8Array|Uint16Array|Int16Array|Uint32Array|Int32Array|Float32Array|Float64Array|string), Object=): Promise<{ data: Buffer, info: Object }>}
+ * @throws {Error} Invalid parameters
+ */
+function prepare (template, options) {
+  if (!(template instanceof this)) {
+    throw is.invalidParameterError('template', 'sharp instance', template);
+  }
+  const { file: _file, buffer: _buffer, streamIn: _streamIn, ...input } = template.options.input;
+  const prepared = sharp.prepare({ ...template.options, input });
+  const { debuglog, queueListener, schedulePriority, scheduleLatency } = template.options;
+  return (image, dimensions) => {
+    if (Array.isArray(image)) {
+      throw is.invalidParameterError('input', 'single image', image);
+    }
+    const call = {
+      prepared,
+      input: template._createInputDescriptor(image, options),
+      debuglog,
+      queueListener,
+      schedulePriority,
+      scheduleLatency
+    };
+    if (is.defined(dimensions)) {
+      if (!is.object(dimensions)) {
+        throw is.invalidParameterError('dimensions', 'object', dimensions);
+      }
+      for (const dimension of ['width', 'height']) {
+        if (is.defined(dimensions[dimension])) {
+          if (is.integer(dimensions[dimension]) && dimensions[dimension] > 0) {
+            call[dimension] = dimensions[dimension];
+          } else {
+            throw is.invalidParameterError(dimension, 'positive integer', dimensions[dimension]);
+          }
+        }
+      }
+    }
+    const stack = Error();
+    return new Promise((resolve, reject) => {
+      template._queuePipeline(call, (err, data, info) => {
+        if (err) {
+          reject(is.nativeError(err, stack));
+        } else {
+          resolve({ data, info });
+        }
+      });
+    });
+  };
+}
+
 /**
  * Decorate the Sharp class with utility-related functions.
  * @module Sharp
@@ -289,7 +553,9 @@ function unblock (options) {
  */
 export default (Sharp) => {
   Sharp.cache = cache;
+  Sharp.resultCache = resultCache;
   Sharp.concurrency = concurrency;
+  Sharp.scheduler = scheduler;
   Sharp.counters = counters;
   Sharp.simd = simd;
   Sharp.format = format;
@@ -298,4 +564,6 @@ export default (Sharp) => {
   Sharp.queue = queue;
   Sharp.block = block;
   Sharp.unblock = unblock;
+  Sharp.batch = batch;
+  Sharp.prepare = prepare;
 };
@@ -108,11 +108,14 @@
       ]
     },
     'sources': [
+      'cache.cc',
       'common.cc',
       'metadata.cc',
       'stats.cc',
       'operations.cc',
       'pipeline.cc',
+      'scheduler.cc',
+      'stream.cc',
       'utilities.cc',
       'sharp.cc'
     ],
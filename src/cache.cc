@@ -0,0 +1,314 @@
+/*!
+  Copyright 2013 Lovell Fuller and others.
+  SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>  // NOLINT(build/c++17)
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <glib.h>
+#include <napi.h>
+#include <vips/vips8>
+
+#include "./cache.h"
+#include "./common.h"
+
+namespace sharp {
+
+  /*
+    Identify the content of an input and the options used to decode it.
+  */
+  std::string InputKey(InputDescriptor *descriptor, bool const byContent) {
+    std::string key;
+    if (descriptor->stream || descriptor->createChannels > 0 || !descriptor->textValue.empty()) {
+      return key;
+    }
+    if (descriptor->buffer != nullptr && descriptor->bufferLength > 0 && !byContent) {
+      key.append("address:").append(std::to_string(reinterpret_cast<uintptr_t>(descriptor->buffer)))
+        .append(":").append(std::to_string(descriptor->bufferLength));
+    } else if (descriptor->buffer != nullptr && descriptor->bufferLength > 0) {
+      gchar *digest = g_compute_checksum_for_data(G_CHECKSUM_SHA256,
+        reinterpret_cast<guchar const*>(descriptor->buffer), descriptor->bufferLength);
+      key.append("buffer:").append(digest);
+      g_free(digest);
+    } else if (!descriptor->file.empty()) {
+      std::error_code err;
+      std::filesystem::path const path = std::filesystem::u8path(descriptor->file);
+      auto const size = std::filesystem::file_size(path, err);
+      if (err) {
+        return key;
+      }
+      auto const modified = std::filesystem::last_write_time(path, err);
+      if (err) {
+        return key;
+      }
+      key.append("file:").append(descriptor->file)
+        .append(":").append(std::to_string(size))
+        .append(":").append(std::to_string(modified.time_since_epoch().count()));
+    } else {
+      return key;
+    }
+    // Options that change the decoded image
+    for (auto const value : {
+      static_cast<double>(descriptor->autoOrient), static_cast<double>(descriptor->failOn),
+      static_cast<double>(descriptor->limitInputPixels), static_cast<double>(descriptor->limitInputChannels),
+      static_cast<double>(descriptor->unlimited), descriptor->density, static_cast<double>(descriptor->ignoreIcc),
+      static_cast<double>(descriptor->rawDepth), static_cast<double>(descriptor->rawChannels),
+      static_cast<double>(descriptor->rawWidth), static_cast<double>(descriptor->rawHeight),
+      static_cast<double>(descriptor->rawPremultiplied), static_cast<double>(descriptor->rawPageHeight),
+      static_cast<double>(descriptor->pages), static_cast<double>(descriptor->page),
+      static_cast<double>(descriptor->svgHighBitdepth), static_cast<double>(descriptor->tiffSubifd),
+      static_cast<double>(descriptor->openSlideLevel), static_cast<double>(descriptor->jp2Oneshot)
+    }) {
+      key.append(":").append(std::to_string(value));
+    }
+    for (double const value : descriptor->pdfBackground) {
+      key.append(":").append(std::to_string(value));
+    }
+    key.append(":").append(descriptor->svgStylesheet);
+    return key;
+  }
+
+  LruCache<VImage>& OverlayCache() {
+    static LruCache<VImage> cache;
+    return cache;
+  }
+
+  /*
+    Open an input used as an overlay, reusing a previously decoded and prepared image when available.
+  */
+  VImage OpenOverlay(InputDescriptor *descriptor, std::string const &purpose,
+    std::function<VImage(VImage)> const &prepare) {
+    LruCache<VImage> &cache = OverlayCache();
+    size_t const maxSize = cache.GetMax();
+    std::string key;
+    if (maxSize > 0) {
+      key = InputKey(descriptor);
+      if (!key.empty()) {
+        key = purpose + "|" + key;
+        VImage image;
+        if (cache.Get(key, &image)) {
+          return image;
+        }
+      }
+    }
+    VImage image;
+    std::tie(image, std::ignore) = OpenInput(descriptor);
+    image = prepare(image);
+    if (!key.empty()) {
+      size_t const size = VIPS_IMAGE_SIZEOF_IMAGE(image.get_image());
+      if (size <= maxSize) {
+        // Decode to memory, shared with other tasks, so no longer sequential
+        image = CopyMemory(image).copy();
+        image.remove(VIPS_META_SEQUENTIAL);
+        cache.Put(key, image, size);
+      }
+    }
+    return image;
+  }
+
+  std::shared_ptr<std::string const> LoadProfile(std::string const &name) {
+    static LruCache<std::shared_ptr<std::string const>> cache;
+    static std::once_flag sized;
+    std::call_once(sized, [] { cache.SetMax(4 * 1048576); });
+    std::string key = name;
+    std::error_code err;
+    std::filesystem::path const path = std::filesystem::u8path(name);
+    if (std::filesystem::is_regular_file(path, err)) {
+      auto const size = std::filesystem::file_size(path, err);
+      auto const modified = std::filesystem::last_write_time(path, err);
+      key.append(":").append(std::to_string(size))
+        .append(":").append(std::to_string(modified.time_since_epoch().count()));
+    }
+    std::shared_ptr<std::string const> profile;
+    if (cache.Get(key, &profile)) {
+      return profile;
+    }
+    VipsBlob *blob = nullptr;
+    if (vips_profile_load(name.data(), &blob, nullptr) != 0 || blob == nullptr) {
+      vips_error_clear();
+      return profile;
+    }
+    size_t length;
+    void const *data = vips_blob_get(blob, &length);
+    profile = std::make_shared<std::string const>(static_cast<char const*>(data), length);
+    vips_area_unref(VIPS_AREA(blob));
+    cache.Put(key, profile, length);
+    return profile;
+  }
+
+  ResultCache& ResultCache::Instance() {
+    static ResultCache cache;
+    return cache;
+  }
+
+  bool ResultCache::Enabled() {
+    return memory.GetMax() > 0 || disk.GetMax() > 0;
+  }
+
+  std::string ResultCache::Path(std::string const &digest) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return directory.empty() ? directory : (std::filesystem::u8path(directory) / digest).string();
+  }
+
+  bool ResultCache::Get(std::string const &key, std::shared_ptr<std::string const> *result) {
+    gchar *checksum = g_compute_checksum_for_string(G_CHECKSUM_SHA256, key.data(), key.size());
+    std::string const digest(checksum);
+    g_free(checksum);
+    if (memory.Get(digest, result)) {
+      hits++;
+      return true;
+    }
+    bool onDisk;
+    if (disk.Get(digest, &onDisk)) {
+      std::ifstream file(std::filesystem::u8path(Path(digest)), std::ios::binary);
+      std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+      if (file.good() || file.eof()) {
+        *result = std::make_shared<std::string const>(std::move(data));
+        memory.Put(digest, *result, (*result)->size());
+        hits++;
+        return true;
+      }
+    }
+    misses++;
+    return false;
+  }
+
+  void ResultCache::Put(std::string const &key, std::string const &result) {
+    gchar *checksum = g_compute_checksum_for_string(G_CHECKSUM_SHA256, key.data(), key.size());
+    std::string const digest(checksum);
+    g_free(checksum);
+    memory.Put(digest, std::make_shared<std::string const>(result), result.size());
+    std::string const path = Path(digest);
+    if (!path.empty() && result.size() <= disk.GetMax()) {
+      // Write to a temporary file then rename, so readers never see a partial result
+      std::string const temporary = path + "." + std::to_string(written++) + ".tmp";
+      std::error_code err;
+      {
+        std::ofstream file(std::filesystem::u8path(temporary), std::ios::binary);
+        file.write(result.data(), result.size());
+        if (!file.good()) {
+          file.close();
+          std::filesystem::remove(std::filesystem::u8path(temporary), err);
+          return;
+        }
+      }
+      std::filesystem::rename(std::filesystem::u8path(temporary), std::filesystem::u8path(path), err);
+      if (err) {
+        std::filesystem::remove(std::filesystem::u8path(temporary), err);
+        return;
+      }
+      disk.Put(digest, true, result.size());
+    }
+  }
+
+  void ResultCache::SetMemory(size_t const max) {
+    memory.SetMax(max);
+  }
+
+  void ResultCache::SetDisk(std::string const &dir, size_t const max) {
+    disk.Clear();
+    disk.SetMax(0);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      directory = max > 0 ? dir : "";
+    }
+    if (max == 0) {
+      return;
+    }
+    std::filesystem::path const path = std::filesystem::u8path(dir);
+    std::error_code err;
+    std::filesystem::create_directories(path, err);
+    if (err) {
+      throw std::runtime_error("Unable to create result cache directory " + dir + ": " + err.message());
+    }
+    disk.OnEvict([path](std::string const &digest) {
+      std::error_code err;
+      std::filesystem::remove(path / digest, err);
+    });
+    disk.SetMax(max);
+    // Reuse results from a previous process, oldest first, removing any partially written
+    std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::directory_entry>> entries;
+    for (auto const &entry : std::filesystem::directory_iterator(path, err)) {
+      std::string const name = entry.path().filename().string();
+      if (name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0) {
+        std::filesystem::remove(entry.path(), err);
+      } else if (name.size() == 64 && entry.is_regular_file(err)) {
+        entries.emplace_back(entry.last_write_time(err), entry);
+      }
+    }
+    std::sort(entries.begin(), entries.end(), [](auto const &a, auto const &b) { return a.first < b.first; });
+    for (auto const &[modified, entry] : entries) {
+      disk.Put(entry.path().filename().string(), true, entry.file_size(err));
+    }
+  }
+
+  ResultCache::Stats ResultCache::GetStats() {
+    return { memory.GetStats(), disk.GetStats(), hits, misses };
+  }
+
+  /*
+    Serialise the options of a task, omitting those that do not change the output.
+  */
+  std::string CanonicalOptions(Napi::Value value) {
+    static std::unordered_set<std::string> const ignored = {
+      "abortPipeline", "abortSignal", "debuglog", "queueListener", "resolveWithObject",
+      "scheduleConcurrency", "scheduleLatency", "schedulePriority", "streamOutput",
+      "timeoutSeconds", "timings", "typedArrayOut", "typedArrayTransferable"
+    };
+    std::string serialised;
+    if (value.IsNumber()) {
+      char number[32];
+      snprintf(number, sizeof(number), "%.17g", value.As<Napi::Number>().DoubleValue());
+      serialised.append("n").append(number);
+    } else if (value.IsString()) {
+      std::string const string = value.As<Napi::String>().Utf8Value();
+      serialised.append("s").append(std::to_string(string.size())).append(":").append(string);
+    } else if (value.IsBoolean()) {
+      serialised.append(value.As<Napi::Boolean>().Value() ? "t" : "f");
+    } else if (value.IsArray()) {
+      Napi::Array array = value.As<Napi::Array>();
+      serialised.append("[");
+      for (uint32_t i = 0; i < array.Length(); i++) {
+        serialised.append(CanonicalOptions(array.Get(i))).append(",");
+      }
+      serialised.append("]");
+    } else if (value.IsObject() && !value.IsFunction() && !value.IsTypedArray() && !value.IsArrayBuffer()) {
+      Napi::Object object = value.As<Napi::Object>();
+      Napi::Array names = object.GetPropertyNames();
+      std::vector<std::string> keys;
+      for (uint32_t i = 0; i < names.Length(); i++) {
+        std::string const key = names.Get(i).As<Napi::String>().Utf8Value();
+        if (ignored.find(key) == ignored.end()) {
+          keys.push_back(key);
+        }
+      }
+      std::sort(keys.begin(), keys.end());
+      serialised.append("{");
+      for (auto const &key : keys) {
+        serialised.append(std::to_string(key.size())).append(":").append(key).append("=")
+          .append(CanonicalOptions(object.Get(key))).append(",");
+      }
+      serialised.append("}");
+    } else {
+      // Functions, Buffers, null and undefined
+      serialised.append("-");
+    }
+    return serialised;
+  }
+
+}  // namespace sharp
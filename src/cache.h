@@ -0,0 +1,203 @@
+/*!
+  Copyright 2013 Lovell Fuller and others.
+  SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef SRC_CACHE_H_
+#define SRC_CACHE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <napi.h>
+#include <vips/vips8>
+
+#include "./common.h"
+
+namespace sharp {
+
+  /*
+    Least recently used cache, limited by the total size of its entries, safe to use from any thread.
+  */
+  template <typename T>
+  class LruCache {
+   public:
+    LruCache() : maxSize(0), size(0), hits(0), misses(0) {}
+
+    // Find an entry, marking it as the most recently used
+    bool Get(std::string const &key, T *value) {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto const found = index.find(key);
+      if (found == index.end()) {
+        misses++;
+        return false;
+      }
+      entries.splice(entries.begin(), entries, found->second);
+      *value = found->second->value;
+      hits++;
+      return true;
+    }
+
+    // Add or replace an entry, evicting the least recently used entries to make room for it
+    void Put(std::string const &key, T const &value, size_t const entrySize) {
+      std::lock_guard<std::mutex> lock(mutex);
+      Remove(key);
+      if (entrySize > maxSize) {
+        return;
+      }
+      entries.push_front({ key, value, entrySize });
+      index[key] = entries.begin();
+      size += entrySize;
+      Trim();
+    }
+
+    // Maximum total size of all entries, zero to disable
+    void SetMax(size_t const max) {
+      std::lock_guard<std::mutex> lock(mutex);
+      maxSize = max;
+      Trim();
+    }
+    size_t GetMax() {
+      std::lock_guard<std::mutex> lock(mutex);
+      return maxSize;
+    }
+
+    // Remove all entries, without notifying of their eviction
+    void Clear() {
+      std::lock_guard<std::mutex> lock(mutex);
+      entries.clear();
+      index.clear();
+      size = 0;
+    }
+
+    // Function to notify of each entry evicted to make room for others
+    void OnEvict(std::function<void(std::string const &key)> const &callback) {
+      std::lock_guard<std::mutex> lock(mutex);
+      onEvict = callback;
+    }
+
+    struct Stats {
+      size_t size;
+      size_t maxSize;
+      size_t items;
+      uint64_t hits;
+      uint64_t misses;
+    };
+    Stats GetStats() {
+      std::lock_guard<std::mutex> lock(mutex);
+      return { size, maxSize, entries.size(), hits, misses };
+    }
+
+   private:
+    struct Entry {
+      std::string key;
+      T value;
+      size_t size;
+    };
+
+    void Remove(std::string const &key) {
+      auto const found = index.find(key);
+      if (found != index.end()) {
+        size -= found->second->size;
+        entries.erase(found->second);
+        index.erase(found);
+      }
+    }
+
+    void Trim() {
+      while (size > maxSize) {
+        std::string const key = entries.back().key;
+        Remove(key);
+        if (onEvict) {
+          onEvict(key);
+        }
+      }
+    }
+
+    std::mutex mutex;
+    std::list<Entry> entries;
+    std::unordered_map<std::string, typename std::list<Entry>::iterator> index;
+    std::function<void(std::string const &key)> onEvict;
+    size_t maxSize;
+    size_t size;
+    uint64_t hits;
+    uint64_t misses;
+  };
+
+  /*
+    Identify the content of an input and the options used to decode it:
+    the SHA-256 digest of a Buffer, or the path, size and modification time of a file.
+    A Buffer can instead be identified by its address and length, valid only while it is referenced.
+    Returns an empty string when the input cannot be identified, e.g. a Stream or a created image.
+  */
+  std::string InputKey(InputDescriptor *descriptor, bool const byContent = true);
+
+  // Decoded composite overlays and boolean operands, ready for use
+  LruCache<VImage>& OverlayCache();
+
+  /*
+    Open an input used as an overlay, prepared for the given purpose, reusing
+    the result of a previous call for the same content while it remains in the overlay cache.
+  */
+  VImage OpenOverlay(InputDescriptor *descriptor, std::string const &purpose,
+    std::function<VImage(VImage)> const &prepare);
+
+  /*
+    Load an ICC profile by filename or built-in name, e.g. "srgb", reusing the data of a previous call
+    for the same name while a file remains unmodified. Returns nullptr when the profile cannot be loaded.
+  */
+  std::shared_ptr<std::string const> LoadProfile(std::string const &name);
+
+  /*
+    Encoded output of tasks, held in memory and optionally on disk, identified by the SHA-256 digest of a key.
+    Entries on disk are files named by digest, those present when setting the directory are reused.
+  */
+  class ResultCache {
+   public:
+    static ResultCache& Instance();
+
+    bool Enabled();
+    // Find a result, from disk when not held in memory
+    bool Get(std::string const &key, std::shared_ptr<std::string const> *result);
+    void Put(std::string const &key, std::string const &result);
+    // Maximum size of results held in memory, in bytes, zero to disable
+    void SetMemory(size_t const max);
+    // Directory and maximum size of results held on disk, in bytes, zero to disable
+    void SetDisk(std::string const &directory, size_t const max);
+
+    struct Stats {
+      LruCache<std::shared_ptr<std::string const>>::Stats memory;
+      LruCache<bool>::Stats disk;
+      uint64_t hits;
+      uint64_t misses;
+    };
+    Stats GetStats();
+
+   private:
+    ResultCache() : hits(0), misses(0), written(0) {}
+    std::string Path(std::string const &digest);
+
+    LruCache<std::shared_ptr<std::string const>> memory;
+    LruCache<bool> disk;
+    std::mutex mutex;
+    std::string directory;
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> written;
+  };
+
+  /*
+    Serialise the options of a task, with object properties sorted by name, omitting the content
+    of any Buffer and properties that do not change the output, e.g. functions and scheduling options.
+  */
+  std::string CanonicalOptions(Napi::Value value);
+
+}  // namespace sharp
+
+#endif  // SRC_CACHE_H_
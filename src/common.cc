@@ -4,7 +4,10 @@
 */
 
 #include <algorithm>
+#include <cmath>
 #include <cstdlib>
+#include <cstring>
+#include <functional>
 #include <map>
 #include <mutex>
 #include <queue>
@@ -16,6 +19,7 @@
 #include <napi.h>
 #include <vips/vips8>
 
+#include "./cache.h"
 #include "./common.h"
 
 using vips::VImage;
@@ -80,6 +84,8 @@ namespace sharp {
       descriptor->bufferLength = buffer.Length();
       descriptor->buffer = buffer.Data();
       descriptor->isBuffer = true;
+    } else if (HasAttr(input, "streamIn")) {
+      descriptor->stream = *input.Get("streamIn").As<Napi::External<std::shared_ptr<InputStream>>>().Data();
     }
     descriptor->failOn = AttrAsEnum<VipsFailOn>(input, "failOn", VIPS_TYPE_FAIL_ON);
     // Density for vector-based input
@@ -90,6 +96,13 @@ namespace sharp {
     if (HasAttr(input, "ignoreIcc")) {
       descriptor->ignoreIcc = AttrAsBool(input, "ignoreIcc");
     }
+    // Should we skip conversion of an embedded profile equivalent to the processing profile
+    if (HasAttr(input, "skipStandardIcc")) {
+      descriptor->skipStandardIcc = AttrAsBool(input, "skipStandardIcc");
+    }
+    if (HasAttr(input, "embeddedThumbnail")) {
+      descriptor->embeddedThumbnail = AttrAsBool(input, "embeddedThumbnail");
+    }
     // Raw pixel input
     if (HasAttr(input, "rawChannels")) {
       descriptor->rawDepth = AttrAsEnum<VipsBandFormat>(input, "rawDepth", VIPS_TYPE_BAND_FORMAT);
@@ -214,6 +227,18 @@ namespace sharp {
   // How many tasks are being processed?
   std::atomic<int> counterProcess{0};
 
+  // How many bytes of pixel data have been copied to memory to keep decoding sequential?
+  std::atomic<uint64_t> counterMaterialised{0};
+
+  // Largest increase in libvips tracked memory during a single task
+  std::atomic<uint64_t> counterMemoryPeak{0};
+
+  // How many tasks have shared the result of an identical task rather than being queued?
+  std::atomic<uint64_t> counterCoalesced{0};
+
+  // Bytes of pixel data copied to memory by the current thread, attributed to the task it is processing
+  thread_local uint64_t threadMaterialised = 0;
+
   // Filename extension checkers
   static bool EndsWith(std::string const &str, std::string const &end) {
     return str.length() >= end.length() && 0 == str.compare(str.length() - end.length(), end.length(), end);
@@ -308,52 +333,67 @@ namespace sharp {
   std::map<std::string, ImageType> loaderToType = {
     { "VipsForeignLoadJpegFile", ImageType::JPEG },
     { "VipsForeignLoadJpegBuffer", ImageType::JPEG },
+    { "VipsForeignLoadJpegSource", ImageType::JPEG },
     { "VipsForeignLoadPngFile", ImageType::PNG },
     { "VipsForeignLoadPngBuffer", ImageType::PNG },
+    { "VipsForeignLoadPngSource", ImageType::PNG },
     { "VipsForeignLoadWebpFile", ImageType::WEBP },
     { "VipsForeignLoadWebpBuffer", ImageType::WEBP },
+    { "VipsForeignLoadWebpSource", ImageType::WEBP },
     { "VipsForeignLoadTiffFile", ImageType::TIFF },
     { "VipsForeignLoadTiffBuffer", ImageType::TIFF },
+    { "VipsForeignLoadTiffSource", ImageType::TIFF },
     { "VipsForeignLoadGifFile", ImageType::GIF },
     { "VipsForeignLoadGifBuffer", ImageType::GIF },
     { "VipsForeignLoadNsgifFile", ImageType::GIF },
     { "VipsForeignLoadNsgifBuffer", ImageType::GIF },
+    { "VipsForeignLoadNsgifSource", ImageType::GIF },
     { "VipsForeignLoadJp2kBuffer", ImageType::JP2 },
     { "VipsForeignLoadJp2kFile", ImageType::JP2 },
+    { "VipsForeignLoadJp2kSource", ImageType::JP2 },
     { "VipsForeignLoadSvgFile", ImageType::SVG },
     { "VipsForeignLoadSvgBuffer", ImageType::SVG },
+    { "VipsForeignLoadSvgSource", ImageType::SVG },
     { "VipsForeignLoadHeifFile", ImageType::HEIF },
     { "VipsForeignLoadHeifBuffer", ImageType::HEIF },
+    { "VipsForeignLoadHeifSource", ImageType::HEIF },
     { "VipsForeignLoadPdfFile", ImageType::PDF },
     { "VipsForeignLoadPdfBuffer", ImageType::PDF },
+    { "VipsForeignLoadPdfSource", ImageType::PDF },
     { "VipsForeignLoadMagickFile", ImageType::MAGICK },
     { "VipsForeignLoadMagickBuffer", ImageType::MAGICK },
     { "VipsForeignLoadMagick7File", ImageType::MAGICK },
     { "VipsForeignLoadMagick7Buffer", ImageType::MAGICK },
+    { "VipsForeignLoadMagick7Source", ImageType::MAGICK },
     { "VipsForeignLoadOpenslideFile", ImageType::OPENSLIDE },
+    { "VipsForeignLoadOpenslideSource", ImageType::OPENSLIDE },
     { "VipsForeignLoadPpmFile", ImageType::PPM },
+    { "VipsForeignLoadPpmSource", ImageType::PPM },
     { "VipsForeignLoadFitsFile", ImageType::FITS },
     { "VipsForeignLoadOpenexr", ImageType::EXR },
     { "VipsForeignLoadJxlFile", ImageType::JXL },
     { "VipsForeignLoadJxlBuffer", ImageType::JXL },
+    { "VipsForeignLoadJxlSource", ImageType::JXL },
     { "VipsForeignLoadRadFile", ImageType::RAD },
     { "VipsForeignLoadRadBuffer", ImageType::RAD },
+    { "VipsForeignLoadRadSource", ImageType::RAD },
     { "VipsForeignLoadDcRawFile", ImageType::DCRAW },
     { "VipsForeignLoadDcRawBuffer", ImageType::DCRAW },
     { "VipsForeignLoadUhdr", ImageType::UHDR },
     { "VipsForeignLoadUhdrFile", ImageType::UHDR },
     { "VipsForeignLoadUhdrBuffer", ImageType::UHDR },
+    { "VipsForeignLoadUhdrSource", ImageType::UHDR },
     { "VipsForeignLoadVips", ImageType::VIPS },
     { "VipsForeignLoadVipsFile", ImageType::VIPS },
+    { "VipsForeignLoadVipsSource", ImageType::VIPS },
     { "VipsForeignLoadRaw", ImageType::RAW }
   };
 
   /*
-    Determine image format of a buffer.
+    Image format read by the loader of the given name, returned by vips_foreign_find_load*
   */
-  ImageType DetermineImageType(void *buffer, size_t const length) {
+  static ImageType LoaderImageType(char const *load) {
     ImageType imageType = ImageType::UNKNOWN;
-    char const *load = vips_foreign_find_load_buffer(buffer, length);
     if (load != nullptr) {
       auto it = loaderToType.find(load);
       if (it != loaderToType.end()) {
@@ -366,6 +406,13 @@ namespace sharp {
     return imageType;
   }
 
+  /*
+    Determine image format of a buffer.
+  */
+  ImageType DetermineImageType(void *buffer, size_t const length) {
+    return LoaderImageType(vips_foreign_find_load_buffer(buffer, length));
+  }
+
   /*
     Determine image format, reads the first few bytes of the file
   */
@@ -373,21 +420,20 @@ namespace sharp {
     ImageType imageType = ImageType::UNKNOWN;
     char const *load = vips_foreign_find_load(file);
     if (load != nullptr) {
-      auto it = loaderToType.find(load);
-      if (it != loaderToType.end()) {
-        imageType = it->second;
-      }
-    } else {
-      if (EndsWith(vips::VError().what(), " does not exist\n")) {
-        imageType = ImageType::MISSING;
-      }
-    }
-    if (imageType == ImageType::UHDR) {
-      imageType = ImageType::JPEG;
+      imageType = LoaderImageType(load);
+    } else if (EndsWith(vips::VError().what(), " does not exist\n")) {
+      imageType = ImageType::MISSING;
     }
     return imageType;
   }
 
+  /*
+    Determine image format of a source, reads and retains the first few bytes
+  */
+  ImageType DetermineImageType(vips::VSource source) {
+    return LoaderImageType(vips_foreign_find_load_source(source.get_source()));
+  }
+
   /*
     Does this image type support multiple pages?
   */
@@ -442,7 +488,8 @@ namespace sharp {
               ->set("background", descriptor->pdfBackground);
         break;
       case ImageType::OPENSLIDE:
-        option->set("level", descriptor->openSlideLevel);
+        // Unset is the full resolution level, unless selected when resizing
+        option->set("level", std::max(0, descriptor->openSlideLevel));
         break;
       case ImageType::JP2:
         option->set("oneshot", descriptor->jp2Oneshot);
@@ -472,13 +519,44 @@ namespace sharp {
     return false;
   }
 
+  /*
+    Load a file input by name with the loader found by OpenInput, avoiding another search.
+    As with VImage::new_from_file, the load is held by the libvips operation cache,
+    which closes the file once the number of open files exceeds the limit set by sharp.cache.
+  */
+  static VImage LoadFile(InputDescriptor *descriptor, vips::VOption *option) {
+    VImage image;
+    VImage::call(descriptor->fileLoader, option->set("filename", descriptor->file.data())->set("out", &image));
+    return image;
+  }
+
   /*
     Open an image from the given InputDescriptor (filesystem, compressed buffer, raw pixel data)
   */
   std::tuple<VImage, ImageType> OpenInput(InputDescriptor *descriptor) {
     VImage image;
     ImageType imageType;
-    if (descriptor->isBuffer) {
+    if (descriptor->stream) {
+      // Compressed data, decoded as it arrives via a Stream
+      vips::VSource source = descriptor->stream->Source();
+      imageType = DetermineImageType(source);
+      if (imageType != ImageType::UNKNOWN) {
+        try {
+          vips::VOption *option = GetOptionsForImageType(imageType, descriptor);
+          image = VImage::new_from_source(source, "", option);
+          if (imageType == ImageType::SVG || imageType == ImageType::PDF || imageType == ImageType::MAGICK) {
+            image = SetDensity(image, descriptor->density);
+          } else if (imageType == ImageType::HEIF && HeifPrimaryPageReopen(image, descriptor)) {
+            option = GetOptionsForImageType(imageType, descriptor);
+            image = VImage::new_from_source(source, "", option);
+          }
+        } catch (std::runtime_error const &err) {
+          throw std::runtime_error(std::string("Input stream has corrupt header: ") + err.what());
+        }
+      } else {
+        throw std::runtime_error("Input stream contains unsupported image format");
+      }
+    } else if (descriptor->isBuffer) {
       if (descriptor->rawChannels > 0) {
         // Raw, uncompressed pixel data
         bool const is8bit = vips_band_format_is8bit(descriptor->rawDepth);
@@ -581,8 +659,15 @@ namespace sharp {
         }
         imageType = ImageType::RAW;
       } else {
-        // From filesystem
-        imageType = DetermineImageType(descriptor->file.data());
+        // From filesystem, finding its loader once for every open of this input
+        if (descriptor->fileLoader == nullptr) {
+          descriptor->fileLoader = vips_foreign_find_load(descriptor->file.data());
+        }
+        if (descriptor->fileLoader != nullptr) {
+          imageType = LoaderImageType(descriptor->fileLoader);
+        } else if (EndsWith(vips::VError().what(), " does not exist\n")) {
+          imageType = ImageType::MISSING;
+        }
         if (imageType == ImageType::MISSING) {
           if (descriptor->file.find("<svg") != std::string::npos) {
             throw std::runtime_error("Input file is missing, did you mean "
@@ -593,12 +678,12 @@ namespace sharp {
         if (imageType != ImageType::UNKNOWN) {
           try {
             vips::VOption *option = GetOptionsForImageType(imageType, descriptor);
-            image = VImage::new_from_file(descriptor->file.data(), option);
+            image = LoadFile(descriptor, option);
             if (imageType == ImageType::SVG || imageType == ImageType::PDF || imageType == ImageType::MAGICK) {
               image = SetDensity(image, descriptor->density);
             } else if (imageType == ImageType::HEIF && HeifPrimaryPageReopen(image, descriptor)) {
               option = GetOptionsForImageType(imageType, descriptor);
-              image = VImage::new_from_file(descriptor->file.data(), option);
+              image = LoadFile(descriptor, option);
             }
           } catch (std::runtime_error const &err) {
             throw std::runtime_error(std::string("Input file has corrupt header: ") + err.what());
@@ -620,6 +705,111 @@ namespace sharp {
     return std::make_tuple(image, imageType);
   }
 
+  /*
+    Find the JPEG thumbnail referenced by IFD1 of EXIF data, returning its offset and length
+    relative to the start of the TIFF header, or a length of zero when there is none.
+  */
+  static std::pair<uint32_t, uint32_t> ExifThumbnail(uint8_t const *tiff, size_t const size) {
+    if (size < 8 || (memcmp(tiff, "II", 2) != 0 && memcmp(tiff, "MM", 2) != 0)) {
+      return { 0, 0 };
+    }
+    bool const bigEndian = tiff[0] == 'M';
+    auto const read = [tiff, bigEndian](size_t const offset, int const bytes) {
+      uint32_t value = 0;
+      for (int i = 0; i < bytes; i++) {
+        value |= static_cast<uint32_t>(tiff[offset + i]) << (8 * (bigEndian ? bytes - 1 - i : i));
+      }
+      return value;
+    };
+    // Skip IFD0 to find IFD1
+    size_t ifd = read(4, 4);
+    if (ifd + 2 > size || ifd + 6 + 12 * read(ifd, 2) > size) {
+      return { 0, 0 };
+    }
+    ifd = read(ifd + 2 + 12 * read(ifd, 2), 4);
+    if (ifd == 0 || ifd + 2 > size || ifd + 2 + 12 * read(ifd, 2) > size) {
+      return { 0, 0 };
+    }
+    uint32_t offset = 0;
+    uint32_t length = 0;
+    for (uint32_t entry = 0; entry < read(ifd, 2); entry++) {
+      size_t const tag = ifd + 2 + 12 * entry;
+      if (read(tag, 2) == 0x0201) {
+        offset = read(tag + 8, 4);
+      } else if (read(tag, 2) == 0x0202) {
+        length = read(tag + 8, 4);
+      }
+    }
+    if (offset == 0 || static_cast<size_t>(offset) + length > size) {
+      return { 0, 0 };
+    }
+    return { offset, length };
+  }
+
+  /*
+    Open the thumbnail embedded in a HEIF image, or in the EXIF data of a JPEG image,
+    with the metadata of the main image.
+  */
+  VImage OpenEmbeddedThumbnail(VImage image, ImageType const imageType, InputDescriptor *descriptor) {
+    VImage thumbnail;
+    if (descriptor->pages != 1) {
+      return thumbnail;
+    }
+    if (imageType == ImageType::HEIF) {
+      // Loads the primary image when there is no thumbnail
+      vips::VOption *option = GetOptionsForImageType(imageType, descriptor)->set("thumbnail", true);
+      if (descriptor->stream) {
+        thumbnail = VImage::heifload_source(descriptor->stream->Source(), option);
+      } else if (descriptor->buffer != nullptr) {
+        VipsBlob *blob = vips_blob_new(nullptr, descriptor->buffer, descriptor->bufferLength);
+        thumbnail = VImage::heifload_buffer(blob, option);
+        vips_area_unref(reinterpret_cast<VipsArea*>(blob));
+      } else {
+        thumbnail = VImage::heifload(const_cast<char*>(descriptor->file.data()), option);
+      }
+      if (thumbnail.width() >= image.width()) {
+        return VImage();
+      }
+    } else if (imageType == ImageType::JPEG && image.get_typeof(VIPS_META_EXIF_NAME) == VIPS_TYPE_BLOB) {
+      size_t size;
+      auto const exif = static_cast<uint8_t const*>(image.get_blob(VIPS_META_EXIF_NAME, &size));
+      // EXIF data starts with "Exif\0\0", followed by a TIFF header
+      if (size <= 6 || memcmp(exif, "Exif", 4) != 0) {
+        return thumbnail;
+      }
+      auto const [offset, length] = ExifThumbnail(exif + 6, size - 6);
+      if (length == 0) {
+        return thumbnail;
+      }
+      VipsBlob *blob = vips_blob_copy(exif + 6 + offset, length);
+      try {
+        thumbnail = VImage::jpegload_buffer(blob, VImage::option()->set("fail_on", descriptor->failOn));
+      } catch (...) {
+        thumbnail = VImage();
+      }
+      vips_area_unref(reinterpret_cast<VipsArea*>(blob));
+      if (thumbnail.is_null()) {
+        return thumbnail;
+      }
+    } else {
+      return thumbnail;
+    }
+    // Thumbnails lack the profile, orientation and other metadata of the main image
+    thumbnail = thumbnail.copy(VImage::option()
+      ->set("xres", image.xres())
+      ->set("yres", image.yres()));
+    for (char const *name : { VIPS_META_ICC_NAME, VIPS_META_EXIF_NAME, VIPS_META_XMP_NAME, VIPS_META_IPTC_NAME,
+      VIPS_META_ORIENTATION, VIPS_META_RESOLUTION_UNIT }) {
+      if (image.get_typeof(name) != 0) {
+        GValue value = { 0, { { 0 } } };
+        vips_image_get(image.get_image(), name, &value);
+        vips_image_set(thumbnail.get_image(), name, &value);
+        g_value_unset(&value);
+      }
+    }
+    return thumbnail;
+  }
+
   /*
     Does this image have an embedded profile?
   */
@@ -653,6 +843,153 @@ namespace sharp {
     return image;
   }
 
+  // Big-endian values of an ICC profile
+  static uint32_t IccUint32(uint8_t const *data) {
+    return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+      (static_cast<uint32_t>(data[2]) << 8) | static_cast<uint32_t>(data[3]);
+  }
+  static double IccFixed(uint8_t const *data) {
+    return static_cast<int32_t>(IccUint32(data)) / 65536.0;
+  }
+
+  /*
+    Find a tag of an ICC profile, returning nullptr when missing or out of bounds.
+  */
+  static uint8_t const *IccTag(uint8_t const *data, size_t const length, char const *signature, size_t *size) {
+    uint32_t const count = IccUint32(data + 128);
+    for (uint64_t i = 0; i < count && 132 + (i + 1) * 12 <= length; i++) {
+      uint8_t const *entry = data + 132 + i * 12;
+      if (memcmp(entry, signature, 4) == 0) {
+        uint64_t const offset = IccUint32(entry + 4);
+        *size = IccUint32(entry + 8);
+        return offset + *size <= length ? data + offset : nullptr;
+      }
+    }
+    return nullptr;
+  }
+
+  /*
+    Is this tone reproduction curve, of type curv or para, the sRGB transfer function?
+  */
+  static bool IsSrgbCurve(uint8_t const *tag, size_t const size) {
+    std::function<double(double)> curve;
+    if (tag != nullptr && size >= 12 && memcmp(tag, "curv", 4) == 0) {
+      uint64_t const count = IccUint32(tag + 8);
+      if (count < 2 || size < 12 + count * 2) {
+        return false;
+      }
+      curve = [tag, count](double const x) {
+        double const position = x * (count - 1);
+        uint64_t const i = std::min(static_cast<uint64_t>(position), count - 2);
+        double const a = ((tag[12 + i * 2] << 8) | tag[13 + i * 2]) / 65535.0;
+        double const b = ((tag[14 + i * 2] << 8) | tag[15 + i * 2]) / 65535.0;
+        return a + (b - a) * (position - i);
+      };
+    } else if (tag != nullptr && size >= 32 && memcmp(tag, "para", 4) == 0 && tag[8] == 0 && tag[9] == 3) {
+      double const g = IccFixed(tag + 12);
+      double const a = IccFixed(tag + 16);
+      double const b = IccFixed(tag + 20);
+      double const c = IccFixed(tag + 24);
+      double const d = IccFixed(tag + 28);
+      curve = [g, a, b, c, d](double const x) {
+        return x >= d ? std::pow(a * x + b, g) : c * x;
+      };
+    } else {
+      return false;
+    }
+    for (int i = 0; i <= 64; i++) {
+      double const x = i / 64.0;
+      double const srgb = x < 0.04045 ? x / 12.92 : std::pow((x + 0.055) / 1.055, 2.4);
+      // Within half of an 8-bit step
+      if (std::abs(curve(x) - srgb) > 0.002) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /*
+    Are the red, green and blue tone reproduction curves of an ICC profile the sRGB transfer function?
+  */
+  static bool HasSrgbCurves(uint8_t const *data, size_t const length) {
+    for (char const *signature : { "rTRC", "gTRC", "bTRC" }) {
+      size_t size = 0;
+      uint8_t const *tag = IccTag(data, length, signature, &size);
+      if (!IsSrgbCurve(tag, size)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /*
+    Are the D50-adapted RGB colourants of an ICC profile those given?
+  */
+  static bool HasColourants(uint8_t const *data, size_t const length, double const (&colourants)[3][3]) {
+    char const *signatures[] = { "rXYZ", "gXYZ", "bXYZ" };
+    for (int i = 0; i < 3; i++) {
+      size_t size = 0;
+      uint8_t const *tag = IccTag(data, length, signatures[i], &size);
+      if (tag == nullptr || size < 20 || memcmp(tag, "XYZ ", 4) != 0) {
+        return false;
+      }
+      for (int j = 0; j < 3; j++) {
+        if (std::abs(IccFixed(tag + 8 + j * 4) - colourants[i][j]) > 0.003) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  /*
+    Identify an embedded profile equivalent to the sRGB or Display P3 processing profile
+    by its RGB colourants and tone reproduction curves, returning "srgb", "p3" or an empty string.
+    Results are held by SHA-256 digest of the profile so each is only examined once.
+  */
+  std::string StandardProfile(VImage image) {
+    if (!HasProfile(image)) {
+      return "";
+    }
+    size_t length;
+    void const *data = image.get_blob(VIPS_META_ICC_NAME, &length);
+    return StandardProfile(data, length);
+  }
+
+  std::string StandardProfile(void const *profile, size_t const length) {
+    static double const srgb[3][3] = {
+      { 0.4361, 0.2225, 0.0139 }, { 0.3851, 0.7169, 0.0971 }, { 0.1431, 0.0606, 0.7141 }
+    };
+    static double const p3[3][3] = {
+      { 0.5151, 0.2412, -0.0011 }, { 0.2920, 0.6922, 0.0419 }, { 0.1571, 0.0666, 0.7841 }
+    };
+    static LruCache<std::string> standards;
+    static std::once_flag sized;
+    std::call_once(sized, [] { standards.SetMax(256); });
+    std::string standard;
+    uint8_t const *data = static_cast<uint8_t const*>(profile);
+    gchar *checksum = g_compute_checksum_for_data(G_CHECKSUM_SHA256, data, length);
+    std::string const digest(checksum);
+    g_free(checksum);
+    if (standards.Get(digest, &standard)) {
+      return standard;
+    }
+    // Matrix and curves of an RGB profile, without lookup tables that would take precedence
+    size_t size = 0;
+    if (
+      length >= 132 && memcmp(data + 16, "RGB ", 4) == 0 && memcmp(data + 20, "XYZ ", 4) == 0 &&
+      IccTag(data, length, "A2B0", &size) == nullptr && HasSrgbCurves(data, length)
+    ) {
+      if (HasColourants(data, length, srgb)) {
+        standard = "srgb";
+      } else if (HasColourants(data, length, p3)) {
+        standard = "p3";
+      }
+    }
+    standards.Put(digest, standard, 1);
+    return standard;
+  }
+
   static void* RemoveExifCallback(VipsImage *image, char const *field, GValue *value, void *data) {
     std::vector<std::string> *fieldNames = static_cast<std::vector<std::string> *>(data);
     std::string fieldName(field);
@@ -846,31 +1183,52 @@ namespace sharp {
   }
 
   /*
-    Attach an event listener for progress updates, used to detect timeout
+    Attach an event listener for progress updates, used to detect timeout and abort,
+    and to sample libvips tracked memory, to a copy of the image that is not shared with
+    other tasks via the libvips operation cache. Returns the copy, which keeps the state alive.
   */
-  void SetTimeout(VImage image, int const seconds) {
-    if (seconds > 0) {
-      VipsImage *im = image.get_image();
-      if (im->progress_signal == NULL) {
-        int *timeout = VIPS_NEW(im, int);
-        *timeout = seconds;
-        g_signal_connect(im, "eval", G_CALLBACK(VipsProgressCallBack), timeout);
-        vips_image_set_progress(im, true);
-      }
+  VImage SetProgress(VImage image, std::shared_ptr<ProgressState> state) {
+    // Written via a new partial image, rather than the cached copy operation
+    VipsImage *im = vips_image_new();
+    if (vips_image_write(image.get_image(), im)) {
+      g_object_unref(im);
+      throw vips::VError();
     }
+    g_object_set_data_full(G_OBJECT(im), "sharp-progress", new std::shared_ptr<ProgressState>(state),
+      [](gpointer data) { delete static_cast<std::shared_ptr<ProgressState>*>(data); });
+    g_signal_connect(im, "eval", G_CALLBACK(VipsProgressCallBack), state.get());
+    vips_image_set_progress(im, true);
+    return VImage(im);
   }
 
   /*
-    Event listener for progress updates, used to detect timeout
+    Event listener for progress updates, used to detect timeout and abort,
+    and to sample libvips tracked memory
   */
-  void VipsProgressCallBack(VipsImage *im, VipsProgress *progress, int *timeout) {
-    if (*timeout > 0 && progress->run >= *timeout) {
+  void VipsProgressCallBack(VipsImage *im, VipsProgress *progress, ProgressState *state) {
+    if (state->sampleMemory) {
+      size_t const memory = vips_tracked_get_mem();
+      size_t peak = state->memoryPeak;
+      while (memory > peak && !state->memoryPeak.compare_exchange_weak(peak, memory)) {}
+    }
+    if (state->timeoutSeconds > 0 && progress->run >= state->timeoutSeconds) {
       vips_image_set_kill(im, true);
       vips_error("timeout", "%d%% complete", progress->percent);
-      *timeout = 0;
+      state->timeoutSeconds = 0;
+    } else if (state->aborted && *state->aborted) {
+      vips_image_set_kill(im, true);
+      vips_error("abort", "%d%% complete", progress->percent);
+      state->aborted.reset();
     }
   }
 
+  /*
+    Update the high-water mark with the current libvips tracked memory
+  */
+  void SampleMemory(size_t *memoryPeak) {
+    *memoryPeak = std::max(*memoryPeak, vips_tracked_get_mem());
+  }
+
   /*
     Calculate the (left, top) coordinates of the output image
     within the input image, applying the given gravity during an embed.
@@ -1078,6 +1436,19 @@ namespace sharp {
     return image;
   }
 
+  /*
+    Does the image have an alpha channel where every pixel is fully opaque?
+  */
+  bool IsOpaque(VImage image) {
+    double const maxAlpha = vips_interpretation_max_alpha(image.interpretation());
+    bool opaque = image.bands() > 1 && image.has_alpha();
+    while (opaque && image.bands() > 1 && image.has_alpha()) {
+      opaque = image.extract_band(image.bands() - 1).min() >= maxAlpha;
+      image = image.extract_band(0, VImage::option()->set("n", image.bands() - 1));
+    }
+    return opaque;
+  }
+
   /*
     Ensures alpha channel, if missing.
   */
@@ -1160,12 +1531,63 @@ namespace sharp {
   */
   VImage StaySequential(VImage image, bool condition) {
     if (vips_image_is_sequential(image.get_image()) && condition) {
-      image = image.copy_memory().copy();
+      image = CopyMemory(image).copy();
       image.remove(VIPS_META_SEQUENTIAL);
     }
     return image;
   }
 
+  /*
+    Render an image to memory, accounting for the bytes copied.
+  */
+  VImage CopyMemory(VImage image) {
+    image = image.copy_memory();
+    uint64_t const bytes = VIPS_IMAGE_SIZEOF_IMAGE(image.get_image());
+    threadMaterialised += bytes;
+    counterMaterialised += bytes;
+    return image;
+  }
+
+  /*
+    Set the number of threads libvips uses to evaluate this image and those derived from it,
+    overriding the process-wide concurrency. Ignored unless greater than zero.
+  */
+  VImage SetConcurrency(VImage image, int const concurrency) {
+    if (concurrency > 0) {
+      // Thread pools are sized from VIPS_META_CONCURRENCY of the image being evaluated, when present
+      image = image.copy();
+      image.set(VIPS_META_CONCURRENCY, concurrency);
+    }
+    return image;
+  }
+
+  /*
+    Number of threads for an output of the given number of pixels, allowing one per megapixel,
+    limited to an equal share of the process-wide concurrency between tasks currently being processed.
+  */
+  int AutoConcurrency(uint64_t const pixels) {
+    int const share = std::max(1, vips_concurrency_get() / std::max(1, static_cast<int>(counterProcess)));
+    int const bySize = static_cast<int>(std::min<uint64_t>(1024, std::max<uint64_t>(1, pixels / 1000000)));
+    return std::min(share, bySize);
+  }
+
+  /*
+    Estimate the working set, in bytes, required to process an image from its header.
+    Sequential access holds a strip of rows per libvips thread, using any concurrency set for this image,
+    otherwise the whole image is held in memory.
+  */
+  size_t EstimateMemory(VImage image, bool const inMemory) {
+    size_t const rowSize = static_cast<size_t>(image.width()) * image.bands() * vips_format_sizeof(image.format());
+    size_t rows = static_cast<size_t>(image.height());
+    if (!inMemory) {
+      int const concurrency = image.get_typeof(VIPS_META_CONCURRENCY) == G_TYPE_INT
+        ? image.get_int(VIPS_META_CONCURRENCY)
+        : vips_concurrency_get();
+      rows = std::min(rows, static_cast<size_t>(128 * std::max(1, concurrency)));
+    }
+    return rowSize * rows;
+  }
+
   /*
     Does this image have a gain map?
   */
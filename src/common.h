@@ -7,6 +7,7 @@
 #define SRC_COMMON_H_
 
 #include <atomic>
+#include <memory>
 #include <string>
 #include <tuple>
 #include <utility>
@@ -15,6 +16,8 @@
 #include <napi.h>
 #include <vips/vips8>
 
+#include "./stream.h"
+
 // Verify platform and compiler compatibility
 
 #if (VIPS_MAJOR_VERSION < 8) || \
@@ -51,8 +54,13 @@ namespace sharp {
     VipsAccess access;
     size_t bufferLength;
     bool isBuffer;
+    std::shared_ptr<InputStream> stream;
+    // Loader found for a file by OpenInput, reused to reopen the file by name
+    char const *fileLoader;
     double density;
     bool ignoreIcc;
+    bool skipStandardIcc;
+    bool embeddedThumbnail;
     VipsBandFormat rawDepth;
     int rawChannels;
     int rawWidth;
@@ -104,8 +112,11 @@ namespace sharp {
       access(VIPS_ACCESS_SEQUENTIAL),
       bufferLength(0),
       isBuffer(false),
+      fileLoader(nullptr),
       density(72.0),
       ignoreIcc(false),
+      skipStandardIcc(false),
+      embeddedThumbnail(false),
       rawDepth(VIPS_FORMAT_UCHAR),
       rawChannels(0),
       rawWidth(0),
@@ -138,7 +149,7 @@ namespace sharp {
       joinValign(VIPS_ALIGN_LOW),
       svgHighBitdepth(false),
       tiffSubifd(-1),
-      openSlideLevel(0),
+      openSlideLevel(-1),
       pdfBackground{ 255.0, 255.0, 255.0, 255.0 },
       jp2Oneshot(false) {}
   };
@@ -202,6 +213,18 @@ namespace sharp {
   // How many tasks are being processed?
   extern std::atomic<int> counterProcess;
 
+  // How many bytes of pixel data have been copied to memory to keep decoding sequential?
+  extern std::atomic<uint64_t> counterMaterialised;
+
+  // Largest increase in libvips tracked memory during a single task
+  extern std::atomic<uint64_t> counterMemoryPeak;
+
+  // How many tasks have shared the result of an identical task rather than being queued?
+  extern std::atomic<uint64_t> counterCoalesced;
+
+  // Bytes of pixel data copied to memory by the current thread, attributed to the task it is processing
+  extern thread_local uint64_t threadMaterialised;
+
   // Filename extension checkers
   bool IsJpeg(std::string const &str);
   bool IsPng(std::string const &str);
@@ -237,6 +260,11 @@ namespace sharp {
   */
   ImageType DetermineImageType(char const *file);
 
+  /*
+    Determine image format of a source.
+  */
+  ImageType DetermineImageType(vips::VSource source);
+
   /*
     Format-specific options builder
   */
@@ -247,6 +275,12 @@ namespace sharp {
   */
   std::tuple<VImage, ImageType> OpenInput(InputDescriptor *descriptor);
 
+  /*
+    Open the thumbnail embedded in a HEIF image, or in the EXIF data of a JPEG image, if any.
+    Returns an empty image when there is no smaller thumbnail, or the input has multiple pages.
+  */
+  VImage OpenEmbeddedThumbnail(VImage image, ImageType const imageType, InputDescriptor *descriptor);
+
   /*
     Does this image have an embedded profile?
   */
@@ -262,6 +296,13 @@ namespace sharp {
   */
   VImage SetProfile(VImage image, std::pair<char*, size_t> icc);
 
+  /*
+    Identify an embedded profile equivalent to the sRGB or Display P3 processing profile
+    by its RGB colourants and tone reproduction curves, returning "srgb", "p3" or an empty string.
+  */
+  std::string StandardProfile(VImage image);
+  std::string StandardProfile(void const *profile, size_t const length);
+
   /*
     Remove all EXIF-related image fields.
   */
@@ -339,14 +380,33 @@ namespace sharp {
   std::string VipsWarningPop();
 
   /*
-    Attach an event listener for progress updates, used to detect timeout
+    State checked on progress updates, owned by the image it is attached to
+  */
+  struct ProgressState {
+    int timeoutSeconds = 0;
+    std::shared_ptr<std::atomic<bool>> aborted;
+    // Sample libvips tracked memory on each update, keeping its high-water mark
+    bool sampleMemory = false;
+    std::atomic<size_t> memoryPeak{0};
+  };
+
+  /*
+    Attach an event listener for progress updates, used to detect timeout and abort,
+    and to sample libvips tracked memory, to a copy of the image that is not shared with
+    other tasks via the libvips operation cache. Returns the copy, which keeps the state alive.
   */
-  void SetTimeout(VImage image, int const timeoutSeconds);
+  VImage SetProgress(VImage image, std::shared_ptr<ProgressState> state);
 
   /*
-    Event listener for progress updates, used to detect timeout
+    Event listener for progress updates, used to detect timeout and abort,
+    and to sample libvips tracked memory
   */
-  void VipsProgressCallBack(VipsImage *image, VipsProgress *progress, int *timeoutSeconds);
+  void VipsProgressCallBack(VipsImage *image, VipsProgress *progress, ProgressState *state);
+
+  /*
+    Update the high-water mark with the current libvips tracked memory
+  */
+  void SampleMemory(size_t *memoryPeak);
 
   /*
     Calculate the (left, top) coordinates of the output image
@@ -390,6 +450,12 @@ namespace sharp {
   */
   VImage RemoveAlpha(VImage image);
 
+  /*
+    Does the image have an alpha channel where every pixel is fully opaque?
+    Reads every pixel, so the image should not be sequential.
+  */
+  bool IsOpaque(VImage image);
+
   /*
     Ensures alpha channel, if missing.
   */
@@ -406,6 +472,29 @@ namespace sharp {
   */
   VImage StaySequential(VImage image, bool condition = true);
 
+  /*
+    Render an image to memory, accounting for the bytes copied.
+  */
+  VImage CopyMemory(VImage image);
+
+  /*
+    Set the number of threads libvips uses to evaluate this image and those derived from it,
+    overriding the process-wide concurrency. Ignored unless greater than zero.
+  */
+  VImage SetConcurrency(VImage image, int const concurrency);
+
+  /*
+    Number of threads for an output of the given number of pixels, allowing one per megapixel,
+    limited to an equal share of the process-wide concurrency between tasks currently being processed.
+  */
+  int AutoConcurrency(uint64_t const pixels);
+
+  /*
+    Estimate the working set, in bytes, required to process an image from its header.
+    Sequential access holds a strip of rows per libvips thread, otherwise the whole image is held in memory.
+  */
+  size_t EstimateMemory(VImage image, bool const inMemory);
+
   /*
     Does this image have a gain map?
   */
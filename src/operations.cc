@@ -6,10 +6,13 @@
 #include <algorithm>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <tuple>
 #include <vector>
 #include <vips/vips8>
 
+#include "./cache.h"
 #include "./common.h"
 #include "./operations.h"
 
@@ -17,9 +20,21 @@ using vips::VImage;
 
 namespace sharp {
   /*
-   * Tint an image using the provided RGB.
+   * Lookup table that maps luminance to the provided RGB, held in memory for reuse by later calls.
    */
-  VImage Tint(VImage image, std::vector<double> const tint) {
+  static VImage TintLut(std::vector<double> const &tint) {
+    // Each table is 768 bytes, so this holds the tables of around 80 colours
+    static LruCache<VImage> cache;
+    static std::once_flag sized;
+    std::call_once(sized, [] { cache.SetMax(65536); });
+    std::string key;
+    for (double const value : tint) {
+      key.append(std::to_string(value)).append(",");
+    }
+    VImage lut;
+    if (cache.Get(key, &lut)) {
+      return lut;
+    }
     std::vector<double> const tintLab = (VImage::black(1, 1) + tint)
       .colourspace(VIPS_INTERPRETATION_LAB, VImage::option()->set("source_space", VIPS_INTERPRETATION_sRGB))
       .getpoint(0, 0);
@@ -33,8 +48,17 @@ namespace sharp {
     VImage weightAB = (weightL * tintLab).extract_band(1, VImage::option()->set("n", 2));
     identityLab = identityLab[0].bandjoin(weightAB);
     // Convert lookup table to sRGB
-    VImage lut = identityLab.colourspace(VIPS_INTERPRETATION_sRGB,
-      VImage::option()->set("source_space", VIPS_INTERPRETATION_LAB));
+    lut = identityLab.colourspace(VIPS_INTERPRETATION_sRGB,
+      VImage::option()->set("source_space", VIPS_INTERPRETATION_LAB)).copy_memory();
+    cache.Put(key, lut, VIPS_IMAGE_SIZEOF_IMAGE(lut.get_image()));
+    return lut;
+  }
+
+  /*
+   * Tint an image using the provided RGB.
+   */
+  VImage Tint(VImage image, std::vector<double> const tint) {
+    VImage const lut = TintLut(tint);
     // Original colourspace
     VipsInterpretation typeBeforeTint = image.interpretation();
     if (typeBeforeTint == VIPS_INTERPRETATION_RGB) {
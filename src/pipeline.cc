@@ -4,13 +4,20 @@
 */
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>  // NOLINT(build/c++17)
+#include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <numeric>
+#include <sstream>
 #include <string>
 #include <tuple>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 #include <sys/types.h>
@@ -19,9 +26,57 @@
 #include <vips/vips8>
 #include <napi.h>
 
+#include "./cache.h"
 #include "./common.h"
 #include "./operations.h"
 #include "./pipeline.h"
+#include "./scheduler.h"
+
+/*
+  Identify a task by its options and all its inputs, by content or, for Buffers, by identity,
+  returning an empty string when any input cannot be identified.
+*/
+static std::string TaskKey(PipelineBaton *baton, std::string key, bool const byContent) {
+  std::vector<sharp::InputDescriptor *> inputs = { baton->input };
+  inputs.insert(inputs.end(), baton->join.begin(), baton->join.end());
+  inputs.insert(inputs.end(), baton->joinChannelIn.begin(), baton->joinChannelIn.end());
+  for (Composite *composite : baton->composite) {
+    inputs.push_back(composite->input);
+  }
+  if (baton->boolean != nullptr) {
+    inputs.push_back(baton->boolean);
+  }
+  for (sharp::InputDescriptor *input : inputs) {
+    std::string const inputKey = sharp::InputKey(input, byContent);
+    if (inputKey.empty()) {
+      return inputKey;
+    }
+    key.append("|").append(inputKey);
+  }
+  return key;
+}
+
+static void DeleteBaton(PipelineBaton *baton) {
+  delete baton->input;
+  delete baton->boolean;
+  for (Composite *composite : baton->composite) {
+    delete composite->input;
+    delete composite;
+  }
+  for (sharp::InputDescriptor *input : baton->joinChannelIn) {
+    delete input;
+  }
+  for (sharp::InputDescriptor *input : baton->join) {
+    delete input;
+  }
+  delete baton;
+}
+
+class PipelineWorker;
+
+// Tasks with Buffer output that are queued or running, by key, to which identical tasks can attach
+static std::mutex inFlightMutex;
+static std::unordered_map<std::string, PipelineWorker *> inFlight;
 
 class PipelineWorker : public Napi::AsyncWorker {
  public:
@@ -30,8 +85,16 @@ class PipelineWorker : public Napi::AsyncWorker {
     Napi::AsyncWorker(callback),
     baton(baton),
     debuglog(Napi::Persistent(debuglog)),
-    queueListener(Napi::Persistent(queueListener)) {}
-  ~PipelineWorker() {}
+    queueListener(Napi::Persistent(queueListener)),
+    completed(std::make_shared<bool>(false)) {}
+  ~PipelineWorker() {
+    *completed = true;
+  }
+
+  // Set once the task has completed, outliving the worker for those that hold it
+  std::shared_ptr<bool const> Completed() const {
+    return completed;
+  }
 
   // libuv worker
   void Execute() {
@@ -40,11 +103,81 @@ class PipelineWorker : public Napi::AsyncWorker {
     // Increment processing task counter
     sharp::counterProcess++;
 
+    if (baton->explain) {
+      Explain(baton);
+    } else if (!baton->fanOut.empty()) {
+      FanOut();
+    } else if (!baton->batch.empty()) {
+      // Continue from any item that was deferred
+      for (; baton->batchNext < baton->batch.size(); baton->batchNext++) {
+        if (*baton->aborted) {
+          // Skip any remaining items
+          baton->err = "The operation was aborted";
+          break;
+        }
+        PipelineBaton *item = baton->batch[baton->batchNext];
+        Process(item);
+        vips_error_clear();
+        if (item->deferred) {
+          item->deferred = false;
+          baton->deferred = true;
+          break;
+        }
+      }
+    } else if (!baton->resultKey.empty()) {
+      ProcessCached(baton);
+    } else {
+      Process(baton);
+    }
+    if (baton->deferred) {
+      // Queued again by the scheduler, to start once its estimated memory fits
+      baton->deferred = false;
+      sharp::counterQueue++;
+      sharp::counterProcess--;
+      vips_error_clear();
+      vips_thread_shutdown();
+      return;
+    }
+    if (*baton->aborted && !baton->err.empty()) {
+      // Processing was interrupted, rather than completing before the abort took effect
+      baton->err = "The operation was aborted";
+    }
+    if (baton->input->stream) {
+      // No further data will be read, so writes to the Writable side no longer need to wait
+      baton->input->stream->Close();
+    }
+    if (baton->streamOut) {
+      // Ensure all data has been passed to the Readable side before signalling completion
+      baton->streamOut->Finish(baton->err.empty());
+    }
+    // Clean up libvips' per-request data and threads
+    vips_error_clear();
+    vips_thread_shutdown();
+  }
+
+  /*
+    Process the image described by baton, setting baton->err on failure.
+  */
+  void Process(PipelineBaton *baton) {
+    if (*baton->aborted) {
+      baton->err = "The operation was aborted";
+      return;
+    }
+    baton->timeStart = std::chrono::steady_clock::now();
+    baton->memoryStart = vips_tracked_get_mem();
+    baton->memoryPeak = baton->memoryStart;
+    sharp::threadMaterialised = 0;
+    InputLevels const levels = GetInputLevels(baton->input);
+    std::shared_ptr<sharp::ProgressState> progress;
     try {
       // Open input
       vips::VImage image;
       sharp::ImageType inputImageType;
-      if (baton->join.empty()) {
+      if (!baton->decodedIn.is_null()) {
+        // Already decoded, shared with other outputs
+        image = baton->decodedIn;
+        inputImageType = baton->decodedInType;
+      } else if (baton->join.empty()) {
         std::tie(image, inputImageType) = sharp::OpenInput(baton->input);
       } else {
         std::vector<VImage> images;
@@ -77,8 +210,11 @@ class PipelineWorker : public Napi::AsyncWorker {
           image.set(VIPS_META_PAGE_HEIGHT, static_cast<int>(image.height() / images.size()));
         }
       }
+      baton->timeOpened = std::chrono::steady_clock::now();
+      sharp::SampleMemory(&baton->memoryPeak);
       VipsAccess access = baton->input->access;
       image = sharp::EnsureColourspace(image, baton->colourspacePipeline);
+      image = sharp::SetConcurrency(image, baton->concurrency);
 
       int nPages = baton->input->pages;
       if (nPages == -1) {
@@ -108,6 +244,14 @@ class PipelineWorker : public Napi::AsyncWorker {
       bool const shouldOrientBefore = (shouldRotateBefore || baton->orientBefore) &&
         (autoRotation != VIPS_ANGLE_D0 || autoFlop);
 
+      // Without shrink-on-load, the image as opened is that to process, so its memory can be estimated now
+      bool const mayPreShrink = ShouldPreShrink(baton, baton->width, baton->height,
+        shouldOrientBefore || shouldRotateBefore);
+      if (!mayPreShrink && !Admit(baton, image, inputImageType, nPages, autoRotation, rotation)) {
+        Defer(baton, levels);
+        return;
+      }
+
       if (shouldOrientBefore) {
         image = sharp::StaySequential(image, autoRotation != VIPS_ANGLE_D0);
         if (autoRotation != VIPS_ANGLE_D0) {
@@ -144,7 +288,8 @@ class PipelineWorker : public Napi::AsyncWorker {
           MultiPageUnsupported(nPages, "Rotate");
           std::vector<double> background;
           std::tie(image, background) = sharp::ApplyAlpha(image, baton->rotationBackground, false);
-          image = image.rotate(baton->rotationAngle, VImage::option()->set("background", background)).copy_memory();
+          image = sharp::CopyMemory(
+            image.rotate(baton->rotationAngle, VImage::option()->set("background", background)));
           baton->rotationAngle = 0.0;
         }
       }
@@ -199,101 +344,33 @@ class PipelineWorker : public Napi::AsyncWorker {
       // WebP, PDF, SVG scale
       double scale = 1.0;
 
-      // Try to reload input using shrink-on-load for JPEG, WebP, SVG and PDF, when:
-      //  - the width or height parameters are specified;
-      //  - gamma correction doesn't need to be applied;
-      //  - trimming or pre-resize extract isn't required;
-      //  - gain map processing is not required;
-      //  - input colourspace is not specified;
-      bool const shouldPreShrink = (targetResizeWidth > 0 || targetResizeHeight > 0) &&
-        baton->gamma == 0 && baton->topOffsetPre == -1 && baton->trimThreshold < 0.0 &&
-        !baton->keepGainMap && !baton->withGainMap &&
-        baton->colourspacePipeline == VIPS_INTERPRETATION_LAST && !(shouldOrientBefore || shouldRotateBefore);
+      bool const shouldPreShrink = ShouldPreShrink(baton, targetResizeWidth, targetResizeHeight,
+        shouldOrientBefore || shouldRotateBefore);
 
       if (shouldPreShrink) {
         // The common part of the shrink: the bit by which both axes must be shrunk
-        double shrink = std::min(hshrink, vshrink);
-
-        if (inputImageType == sharp::ImageType::JPEG) {
-          // Leave at least a factor of two for the final resize step, when fastShrinkOnLoad: false
-          // for more consistent results and to avoid extra sharpness to the image
-          int factor = baton->fastShrinkOnLoad ? 1 : 2;
-          if (shrink >= 8 * factor) {
-            jpegShrinkOnLoad = 8;
-          } else if (shrink >= 4 * factor) {
-            jpegShrinkOnLoad = 4;
-          } else if (shrink >= 2 * factor) {
-            jpegShrinkOnLoad = 2;
-          }
-          // Lower shrink-on-load for known libjpeg rounding errors
-          if (jpegShrinkOnLoad > 1 && static_cast<int>(shrink) == jpegShrinkOnLoad) {
-            jpegShrinkOnLoad /= 2;
+        std::tie(jpegShrinkOnLoad, scale) = CalculateShrinkOnLoad(inputImageType, std::min(hshrink, vshrink),
+          baton->fastShrinkOnLoad);
+        scale *= SelectPyramidLevel(image, inputImageType, baton->input, std::min(hshrink, vshrink));
+        if (baton->input->embeddedThumbnail) {
+          // Prefer a thumbnail, avoiding decode of the main image
+          VImage thumbnail = SuitableEmbeddedThumbnail(image, inputImageType, baton->input, std::min(hshrink, vshrink));
+          if (!thumbnail.is_null()) {
+            scale = static_cast<double>(thumbnail.width()) / image.width();
+            jpegShrinkOnLoad = 1;
+            image = thumbnail;
+            baton->embeddedThumbnailUsed = true;
           }
-        } else if (inputImageType == sharp::ImageType::WEBP && baton->fastShrinkOnLoad && shrink > 1.0) {
-          // Avoid upscaling via webp
-          scale = 1.0 / shrink;
-        } else if (inputImageType == sharp::ImageType::SVG ||
-                   inputImageType == sharp::ImageType::PDF) {
-          scale = 1.0 / shrink;
         }
       }
-
-      // Reload input using shrink-on-load, it'll be an integer shrink
-      // factor for jpegload*, a double scale factor for webpload*,
-      // pdfload* and svgload*
-      if (jpegShrinkOnLoad > 1) {
-        vips::VOption *option = GetOptionsForImageType(inputImageType, baton->input)->set("shrink", jpegShrinkOnLoad);
-        if (baton->input->buffer != nullptr) {
-          // Reload JPEG buffer
-          VipsBlob *blob = vips_blob_new(nullptr, baton->input->buffer, baton->input->bufferLength);
-          image = VImage::jpegload_buffer(blob, option);
-          vips_area_unref(reinterpret_cast<VipsArea*>(blob));
-        } else {
-          // Reload JPEG file
-          image = VImage::jpegload(const_cast<char*>(baton->input->file.data()), option);
-        }
-      } else if (scale != 1.0) {
-        vips::VOption *option = GetOptionsForImageType(inputImageType, baton->input)->set("scale", scale);
-        if (inputImageType == sharp::ImageType::WEBP) {
-          if (baton->input->buffer != nullptr) {
-            // Reload WebP buffer
-            VipsBlob *blob = vips_blob_new(nullptr, baton->input->buffer, baton->input->bufferLength);
-            image = VImage::webpload_buffer(blob, option);
-            vips_area_unref(reinterpret_cast<VipsArea*>(blob));
-          } else {
-            // Reload WebP file
-            image = VImage::webpload(const_cast<char*>(baton->input->file.data()), option);
-          }
-        } else if (inputImageType == sharp::ImageType::SVG) {
-          if (baton->input->buffer != nullptr) {
-            // Reload SVG buffer
-            VipsBlob *blob = vips_blob_new(nullptr, baton->input->buffer, baton->input->bufferLength);
-            image = VImage::svgload_buffer(blob, option);
-            vips_area_unref(reinterpret_cast<VipsArea*>(blob));
-          } else {
-            // Reload SVG file
-            image = VImage::svgload(const_cast<char*>(baton->input->file.data()), option);
-          }
-          sharp::SetDensity(image, baton->input->density);
-          if (image.width() > 32767 || image.height() > 32767) {
-            throw std::runtime_error("Input SVG image will exceed 32767x32767 pixel limit when scaled");
-          }
-        } else if (inputImageType == sharp::ImageType::PDF) {
-          if (baton->input->buffer != nullptr) {
-            // Reload PDF buffer
-            VipsBlob *blob = vips_blob_new(nullptr, baton->input->buffer, baton->input->bufferLength);
-            image = VImage::pdfload_buffer(blob, option);
-            vips_area_unref(reinterpret_cast<VipsArea*>(blob));
-          } else {
-            // Reload PDF file
-            image = VImage::pdfload(const_cast<char*>(baton->input->file.data()), option);
-          }
-          sharp::SetDensity(image, baton->input->density);
-        }
-      } else {
-        if (inputImageType == sharp::ImageType::SVG && (image.width() > 32767 || image.height() > 32767)) {
-          throw std::runtime_error("Input SVG image exceeds 32767x32767 pixel limit");
-        }
+      if (!baton->embeddedThumbnailUsed) {
+        image = ReloadWithShrinkOnLoad(image, inputImageType, baton->input, jpegShrinkOnLoad, scale);
+      }
+      // Any reload or thumbnail is a new image, without the concurrency set when opened
+      image = sharp::SetConcurrency(image, baton->concurrency);
+      if (mayPreShrink && !Admit(baton, image, inputImageType, nPages, autoRotation, rotation)) {
+        Defer(baton, levels);
+        return;
       }
       if (baton->input->autoOrient) {
         image = sharp::RemoveExifOrientation(image);
@@ -355,14 +432,19 @@ class PipelineWorker : public Napi::AsyncWorker {
         baton->colourspacePipeline != VIPS_INTERPRETATION_CMYK &&
         !baton->input->ignoreIcc && !baton->withGainMap
       ) {
-        // Convert to sRGB/P3 using embedded profile
-        try {
-          image = image.icc_transform(processingProfile, VImage::option()
-            ->set("embedded", true)
-            ->set("depth", sharp::Is16Bit(image.interpretation()) ? 16 : 8)
-            ->set("intent", VIPS_INTENT_PERCEPTUAL));
-        } catch(...) {
-          sharp::VipsWarningCallback(nullptr, G_LOG_LEVEL_WARNING, "Invalid embedded profile", nullptr);
+        if (baton->input->skipStandardIcc && sharp::StandardProfile(image) == processingProfile) {
+          // Embedded profile is equivalent to sRGB/P3, so conversion would leave pixel values unchanged
+          baton->iccSkipped = true;
+        } else {
+          // Convert to sRGB/P3 using embedded profile
+          try {
+            image = image.icc_transform(processingProfile, VImage::option()
+              ->set("embedded", true)
+              ->set("depth", sharp::Is16Bit(image.interpretation()) ? 16 : 8)
+              ->set("intent", VIPS_INTENT_PERCEPTUAL));
+          } catch(...) {
+            sharp::VipsWarningCallback(nullptr, G_LOG_LEVEL_WARNING, "Invalid embedded profile", nullptr);
+          }
         }
       } else if (
         image.interpretation() == VIPS_INTERPRETATION_CMYK &&
@@ -394,6 +476,15 @@ class PipelineWorker : public Napi::AsyncWorker {
       bool const shouldSharpen = baton->sharpenSigma != 0.0;
       bool const shouldComposite = !baton->composite.empty();
 
+      // Remove a fully opaque alpha channel, avoiding the need to premultiply
+      if (ShouldRemoveAlphaIfOpaque(baton, image, inputImageType,
+        shouldResize || shouldBlur || shouldConv || shouldSharpen)) {
+        image = sharp::StaySequential(image);
+        if (sharp::IsOpaque(image)) {
+          image = sharp::RemoveAlpha(image);
+        }
+      }
+
       if (shouldComposite && !image.has_alpha()) {
         image = sharp::EnsureAlpha(image, 1);
       }
@@ -548,8 +639,11 @@ class PipelineWorker : public Napi::AsyncWorker {
             baton->cropOffsetLeft = static_cast<int>(image.xoffset());
             baton->cropOffsetTop = static_cast<int>(image.yoffset());
             baton->hasAttentionCenter = true;
-            baton->attentionX = static_cast<int>(attention_x * jpegShrinkOnLoad / scale);
-            baton->attentionY = static_cast<int>(attention_y * jpegShrinkOnLoad / scale);
+            // Relative to the input, including any shrink-on-load shared with other outputs
+            double const attentionScale = static_cast<double>(jpegShrinkOnLoad * baton->decodedInShrink) /
+              (scale * baton->decodedInScale);
+            baton->attentionX = static_cast<int>(attention_x * attentionScale);
+            baton->attentionY = static_cast<int>(attention_y * attentionScale);
           }
         }
       }
@@ -702,28 +796,31 @@ class PipelineWorker : public Napi::AsyncWorker {
         std::vector<VImage> images = { image };
         std::vector<int> modes, xs, ys;
         for (Composite *composite : baton->composite) {
-          VImage compositeImage;
-          sharp::ImageType compositeImageType = sharp::ImageType::UNKNOWN;
           composite->input->access = access;
-          std::tie(compositeImage, compositeImageType) = sharp::OpenInput(composite->input);
-
-          if (composite->input->autoOrient) {
-            // Respect EXIF Orientation
-            VipsAngle compositeAutoRotation = VIPS_ANGLE_D0;
-            bool compositeAutoFlop = false;
-            std::tie(compositeAutoRotation, compositeAutoFlop) =
-              CalculateExifRotationAndFlop(sharp::ExifOrientation(compositeImage));
-
-            compositeImage = sharp::RemoveExifOrientation(compositeImage);
-            compositeImage = sharp::StaySequential(compositeImage, compositeAutoRotation != VIPS_ANGLE_D0);
-
-            if (compositeAutoRotation != VIPS_ANGLE_D0) {
-              compositeImage = compositeImage.rot(compositeAutoRotation);
-            }
-            if (compositeAutoFlop) {
-              compositeImage = compositeImage.flip(VIPS_DIRECTION_HORIZONTAL);
+          std::string const purpose = composite->premultiplied ? "composite-premultiplied" : "composite";
+          VImage compositeImage = sharp::OpenOverlay(composite->input, purpose, [&](VImage compositeImage) {
+            if (composite->input->autoOrient) {
+              // Respect EXIF Orientation
+              VipsAngle compositeAutoRotation = VIPS_ANGLE_D0;
+              bool compositeAutoFlop = false;
+              std::tie(compositeAutoRotation, compositeAutoFlop) =
+                CalculateExifRotationAndFlop(sharp::ExifOrientation(compositeImage));
+
+              compositeImage = sharp::RemoveExifOrientation(compositeImage);
+              compositeImage = sharp::StaySequential(compositeImage, compositeAutoRotation != VIPS_ANGLE_D0);
+
+              if (compositeAutoRotation != VIPS_ANGLE_D0) {
+                compositeImage = compositeImage.rot(compositeAutoRotation);
+              }
+              if (compositeAutoFlop) {
+                compositeImage = compositeImage.flip(VIPS_DIRECTION_HORIZONTAL);
+              }
             }
-          }
+            // Ensure image to composite is with unpremultiplied alpha
+            compositeImage = sharp::EnsureAlpha(compositeImage, 1);
+            if (composite->premultiplied) compositeImage = compositeImage.unpremultiply();
+            return compositeImage;
+          });
 
           // Verify within current dimensions
           if (compositeImage.width() > image.width() || compositeImage.height() > image.height()) {
@@ -765,9 +862,6 @@ class PipelineWorker : public Napi::AsyncWorker {
             // gravity was used for extract_area, set it back to its default value of 0
             composite->gravity = 0;
           }
-          // Ensure image to composite is with unpremultiplied alpha
-          compositeImage = sharp::EnsureAlpha(compositeImage, 1);
-          if (composite->premultiplied) compositeImage = compositeImage.unpremultiply();
           // Calculate position
           int left;
           int top;
@@ -826,11 +920,12 @@ class PipelineWorker : public Napi::AsyncWorker {
       // Apply bitwise boolean operation between images
       if (baton->boolean != nullptr) {
         KeepGainMapUnsupported(baton->keepGainMap, "Boolean");
-        VImage booleanImage;
-        sharp::ImageType booleanImageType = sharp::ImageType::UNKNOWN;
         baton->boolean->access = access;
-        std::tie(booleanImage, booleanImageType) = sharp::OpenInput(baton->boolean);
-        booleanImage = sharp::EnsureColourspace(booleanImage, baton->colourspacePipeline);
+        VipsInterpretation const colourspacePipeline = baton->colourspacePipeline;
+        VImage booleanImage = sharp::OpenOverlay(baton->boolean,
+          "boolean-" + std::to_string(colourspacePipeline), [colourspacePipeline](VImage booleanImage) {
+            return sharp::EnsureColourspace(booleanImage, colourspacePipeline);
+          });
         image = sharp::Boolean(image, booleanImage, baton->booleanOp);
         image = sharp::RemoveGifPalette(image);
       }
@@ -876,7 +971,7 @@ class PipelineWorker : public Napi::AsyncWorker {
             (baton->err)
               .append("Cannot extract channel ").append(std::to_string(baton->extractChannel))
               .append(" from image with channels 0-").append(std::to_string(image.bands() - 1));
-            return Error();
+            return;
           }
         }
         VipsInterpretation colourspace = sharp::Is16Bit(image.interpretation())
@@ -889,14 +984,33 @@ class PipelineWorker : public Napi::AsyncWorker {
 
       // Apply output ICC profile
       if (!baton->withIccProfile.empty()) {
-        try {
-          image = image.icc_transform(const_cast<char*>(baton->withIccProfile.data()), VImage::option()
-            ->set("input_profile", processingProfile)
-            ->set("embedded", true)
-            ->set("depth", sharp::Is16Bit(image.interpretation()) ? 16 : 8)
-            ->set("intent", VIPS_INTENT_PERCEPTUAL));
-        } catch(...) {
-          sharp::VipsWarningCallback(nullptr, G_LOG_LEVEL_WARNING, "Invalid profile", nullptr);
+        // Profile of the pixel values, as used by the transform, compared with the output profile
+        std::string const currentProfile = sharp::HasProfile(image)
+          ? sharp::StandardProfile(image)
+          : processingProfile;
+        std::shared_ptr<std::string const> const outputProfile = sharp::LoadProfile(baton->withIccProfile);
+        bool const isRgb = image.interpretation() == VIPS_INTERPRETATION_sRGB ||
+          image.interpretation() == VIPS_INTERPRETATION_RGB16;
+        if (
+          isRgb && outputProfile != nullptr && !currentProfile.empty() &&
+          currentProfile == sharp::StandardProfile(outputProfile->data(), outputProfile->size())
+        ) {
+          // Equivalent profiles, so attach the output profile without transforming pixel values
+          size_t const length = outputProfile->size();
+          void *icc = g_malloc(length);
+          memcpy(icc, outputProfile->data(), length);
+          image = image.copy();
+          image.set(VIPS_META_ICC_NAME, reinterpret_cast<VipsCallbackFn>(vips_area_free_cb), icc, length);
+        } else {
+          try {
+            image = image.icc_transform(const_cast<char*>(baton->withIccProfile.data()), VImage::option()
+              ->set("input_profile", processingProfile)
+              ->set("embedded", true)
+              ->set("depth", sharp::Is16Bit(image.interpretation()) ? 16 : 8)
+              ->set("intent", VIPS_INTENT_PERCEPTUAL));
+          } catch(...) {
+            sharp::VipsWarningCallback(nullptr, G_LOG_LEVEL_WARNING, "Invalid profile", nullptr);
+          }
         }
       }
 
@@ -947,21 +1061,38 @@ class PipelineWorker : public Napi::AsyncWorker {
       baton->hasAlphaOut = image.has_alpha();
 
       // Output
-      sharp::SetTimeout(image, baton->timeoutSeconds);
+      baton->timeOutput = std::chrono::steady_clock::now();
+      sharp::SampleMemory(&baton->memoryPeak);
+      if (baton->concurrency == -1) {
+        image = sharp::SetConcurrency(image, sharp::AutoConcurrency(
+          static_cast<uint64_t>(baton->width) * static_cast<uint64_t>(baton->height)));
+      }
+      if (image.get_typeof(VIPS_META_CONCURRENCY) == G_TYPE_INT) {
+        baton->concurrencyOut = image.get_int(VIPS_META_CONCURRENCY);
+      }
+      if (baton->timeoutSeconds > 0 || baton->abortable || baton->timings) {
+        progress = std::make_shared<sharp::ProgressState>();
+        progress->timeoutSeconds = baton->timeoutSeconds;
+        if (baton->abortable) {
+          progress->aborted = baton->aborted;
+        }
+        // Sampling takes a global lock, so only throughout output when timings are requested
+        progress->sampleMemory = baton->timings;
+        image = sharp::SetProgress(image, progress);
+      }
       if (baton->fileOut.empty()) {
         // Buffer output
         if (baton->formatOut == "jpeg" || (baton->formatOut == "input" && inputImageType == sharp::ImageType::JPEG)) {
           // Write JPEG to buffer
           sharp::AssertImageTypeDimensions(image, sharp::ImageType::JPEG);
-          VipsArea *area;
           if (baton->keepGainMap) {
             image = ReattachGainMap(image, gainMap, baton);
-            area = reinterpret_cast<VipsArea*>(image.uhdrsave_buffer(VImage::option()
+            SaveBuffer(image, "uhdr", VImage::option()
               ->set("keep", baton->keepMetadata)
               ->set("Q", baton->jpegQuality)
-              ->set("gainmap_scale_factor", gainMapScaleFactor)));
+              ->set("gainmap_scale_factor", gainMapScaleFactor), baton);
           } else {
-            area = reinterpret_cast<VipsArea*>(image.jpegsave_buffer(VImage::option()
+            SaveBuffer(image, "jpeg", VImage::option()
               ->set("keep", baton->keepMetadata)
               ->set("Q", baton->jpegQuality)
               ->set("interlace", baton->jpegProgressive)
@@ -972,12 +1103,8 @@ class PipelineWorker : public Napi::AsyncWorker {
               ->set("quant_table", baton->jpegQuantisationTable)
               ->set("overshoot_deringing", baton->jpegOvershootDeringing)
               ->set("optimize_scans", baton->jpegOptimiseScans)
-              ->set("optimize_coding", baton->jpegOptimiseCoding)));
+              ->set("optimize_coding", baton->jpegOptimiseCoding), baton);
           }
-          baton->bufferOut = static_cast<char*>(area->data);
-          baton->bufferOutLength = area->length;
-          area->free_fn = nullptr;
-          vips_area_unref(area);
           baton->formatOut = "jpeg";
           if (baton->colourspace == VIPS_INTERPRETATION_CMYK) {
             baton->channels = std::min(baton->channels, 4);
@@ -989,23 +1116,19 @@ class PipelineWorker : public Napi::AsyncWorker {
           && inputImageType == sharp::ImageType::JP2)) {
           // Write JP2 to Buffer
           sharp::AssertImageTypeDimensions(image, sharp::ImageType::JP2);
-          VipsArea *area = reinterpret_cast<VipsArea*>(image.jp2ksave_buffer(VImage::option()
+          SaveBuffer(image, "jp2k", VImage::option()
             ->set("Q", baton->jp2Quality)
             ->set("lossless", baton->jp2Lossless)
             ->set("subsample_mode", baton->jp2ChromaSubsampling == "4:4:4"
               ? VIPS_FOREIGN_SUBSAMPLE_OFF : VIPS_FOREIGN_SUBSAMPLE_ON)
             ->set("tile_height", baton->jp2TileHeight)
-            ->set("tile_width", baton->jp2TileWidth)));
-          baton->bufferOut = static_cast<char*>(area->data);
-          baton->bufferOutLength = area->length;
-          area->free_fn = nullptr;
-          vips_area_unref(area);
+            ->set("tile_width", baton->jp2TileWidth), baton);
           baton->formatOut = "jp2";
         } else if (baton->formatOut == "png" || (baton->formatOut == "input" &&
           (inputImageType == sharp::ImageType::PNG || inputImageType == sharp::ImageType::SVG))) {
           // Write PNG to buffer
           sharp::AssertImageTypeDimensions(image, sharp::ImageType::PNG);
-          VipsArea *area = reinterpret_cast<VipsArea*>(image.pngsave_buffer(VImage::option()
+          SaveBuffer(image, "png", VImage::option()
             ->set("keep", baton->keepMetadata)
             ->set("interlace", baton->pngProgressive)
             ->set("compression", baton->pngCompressionLevel)
@@ -1014,17 +1137,13 @@ class PipelineWorker : public Napi::AsyncWorker {
             ->set("Q", baton->pngQuality)
             ->set("effort", baton->pngEffort)
             ->set("bitdepth", sharp::Is16Bit(image.interpretation()) ? 16 : baton->pngBitdepth)
-            ->set("dither", baton->pngDither)));
-          baton->bufferOut = static_cast<char*>(area->data);
-          baton->bufferOutLength = area->length;
-          area->free_fn = nullptr;
-          vips_area_unref(area);
+            ->set("dither", baton->pngDither), baton);
           baton->formatOut = "png";
         } else if (baton->formatOut == "webp" ||
           (baton->formatOut == "input" && inputImageType == sharp::ImageType::WEBP)) {
           // Write WEBP to buffer
           sharp::AssertImageTypeDimensions(image, sharp::ImageType::WEBP);
-          VipsArea *area = reinterpret_cast<VipsArea*>(image.webpsave_buffer(VImage::option()
+          SaveBuffer(image, "webp", VImage::option()
             ->set("keep", baton->keepMetadata)
             ->set("Q", baton->webpQuality)
             ->set("lossless", baton->webpLossless)
@@ -1036,17 +1155,13 @@ class PipelineWorker : public Napi::AsyncWorker {
             ->set("min_size", baton->webpMinSize)
             ->set("mixed", baton->webpMixed)
             ->set("exact", baton->webpExact)
-            ->set("alpha_q", baton->webpAlphaQuality)));
-          baton->bufferOut = static_cast<char*>(area->data);
-          baton->bufferOutLength = area->length;
-          area->free_fn = nullptr;
-          vips_area_unref(area);
+            ->set("alpha_q", baton->webpAlphaQuality), baton);
           baton->formatOut = "webp";
         } else if (baton->formatOut == "gif" ||
           (baton->formatOut == "input" && inputImageType == sharp::ImageType::GIF)) {
           // Write GIF to buffer
           sharp::AssertImageTypeDimensions(image, sharp::ImageType::GIF);
-          VipsArea *area = reinterpret_cast<VipsArea*>(image.gifsave_buffer(VImage::option()
+          SaveBuffer(image, "gif", VImage::option()
             ->set("keep", baton->keepMetadata)
             ->set("bitdepth", baton->gifBitdepth)
             ->set("effort", baton->gifEffort)
@@ -1055,11 +1170,7 @@ class PipelineWorker : public Napi::AsyncWorker {
             ->set("interframe_maxerror", baton->gifInterFrameMaxError)
             ->set("interpalette_maxerror", baton->gifInterPaletteMaxError)
             ->set("keep_duplicate_frames", baton->gifKeepDuplicateFrames)
-            ->set("dither", baton->gifDither)));
-          baton->bufferOut = static_cast<char*>(area->data);
-          baton->bufferOutLength = area->length;
-          area->free_fn = nullptr;
-          vips_area_unref(area);
+            ->set("dither", baton->gifDither), baton);
           baton->formatOut = "gif";
         } else if (baton->formatOut == "tiff" ||
           (baton->formatOut == "input" && inputImageType == sharp::ImageType::TIFF)) {
@@ -1073,7 +1184,7 @@ class PipelineWorker : public Napi::AsyncWorker {
           if (baton->tiffPredictor == VIPS_FOREIGN_TIFF_PREDICTOR_FLOAT) {
             image = image.cast(VIPS_FORMAT_FLOAT);
           }
-          VipsArea *area = reinterpret_cast<VipsArea*>(image.tiffsave_buffer(VImage::option()
+          SaveBuffer(image, "tiff", VImage::option()
             ->set("keep", baton->keepMetadata)
             ->set("Q", baton->tiffQuality)
             ->set("bitdepth", baton->tiffBitdepth)
@@ -1087,18 +1198,14 @@ class PipelineWorker : public Napi::AsyncWorker {
             ->set("tile_width", baton->tiffTileWidth)
             ->set("xres", baton->tiffXres)
             ->set("yres", baton->tiffYres)
-            ->set("resunit", baton->tiffResolutionUnit)));
-          baton->bufferOut = static_cast<char*>(area->data);
-          baton->bufferOutLength = area->length;
-          area->free_fn = nullptr;
-          vips_area_unref(area);
+            ->set("resunit", baton->tiffResolutionUnit), baton);
           baton->formatOut = "tiff";
         } else if (baton->formatOut == "heif" ||
           (baton->formatOut == "input" && inputImageType == sharp::ImageType::HEIF)) {
           // Write HEIF to buffer
           sharp::AssertImageTypeDimensions(image, sharp::ImageType::HEIF);
           image = sharp::RemoveAnimationProperties(image);
-          VipsArea *area = reinterpret_cast<VipsArea*>(image.heifsave_buffer(VImage::option()
+          SaveBuffer(image, "heif", VImage::option()
             ->set("keep", baton->keepMetadata)
             ->set("Q", baton->heifQuality)
             ->set("compression", baton->heifCompression)
@@ -1107,11 +1214,7 @@ class PipelineWorker : public Napi::AsyncWorker {
             ->set("tune", baton->heifTune.c_str())
             ->set("subsample_mode", baton->heifChromaSubsampling == "4:4:4"
               ? VIPS_FOREIGN_SUBSAMPLE_OFF : VIPS_FOREIGN_SUBSAMPLE_ON)
-            ->set("lossless", baton->heifLossless)));
-          baton->bufferOut = static_cast<char*>(area->data);
-          baton->bufferOutLength = area->length;
-          area->free_fn = nullptr;
-          vips_area_unref(area);
+            ->set("lossless", baton->heifLossless), baton);
           baton->formatOut = "heif";
         } else if (baton->formatOut == "dz") {
           // Write DZ to buffer
@@ -1121,11 +1224,7 @@ class PipelineWorker : public Napi::AsyncWorker {
           }
           image = sharp::StaySequential(image, baton->tileAngle != 0);
           vips::VOption *options = BuildOptionsDZ(baton);
-          VipsArea *area = reinterpret_cast<VipsArea*>(image.dzsave_buffer(options));
-          baton->bufferOut = static_cast<char*>(area->data);
-          baton->bufferOutLength = area->length;
-          area->free_fn = nullptr;
-          vips_area_unref(area);
+          SaveBuffer(image, "dz", options, baton);
           baton->formatOut = "dz";
           if (baton->tileFormat == "jpeg") {
             baton->hasAlphaOut = false;
@@ -1134,16 +1233,12 @@ class PipelineWorker : public Napi::AsyncWorker {
           (baton->formatOut == "input" && inputImageType == sharp::ImageType::JXL)) {
           // Write JXL to buffer
           image = sharp::RemoveAnimationProperties(image);
-          VipsArea *area = reinterpret_cast<VipsArea*>(image.jxlsave_buffer(VImage::option()
+          SaveBuffer(image, "jxl", VImage::option()
             ->set("keep", baton->keepMetadata)
             ->set("distance", baton->jxlDistance)
             ->set("tier", baton->jxlDecodingTier)
             ->set("effort", baton->jxlEffort)
-            ->set("lossless", baton->jxlLossless)));
-          baton->bufferOut = static_cast<char*>(area->data);
-          baton->bufferOutLength = area->length;
-          area->free_fn = nullptr;
-          vips_area_unref(area);
+            ->set("lossless", baton->jxlLossless), baton);
           baton->formatOut = "jxl";
         } else if (baton->formatOut == "raw" ||
           (baton->formatOut == "input" && inputImageType == sharp::ImageType::RAW)) {
@@ -1357,30 +1452,31 @@ class PipelineWorker : public Napi::AsyncWorker {
         } else {
           // Unsupported output format
           (baton->err).append("Unsupported output format " + baton->fileOut);
-          return Error();
+          return;
         }
       }
     } catch (std::runtime_error const &err) {
-      char const *what = err.what();
-      if (what && what[0]) {
-        (baton->err).append(what);
-      } else {
-        if (baton->input->failOn == VIPS_FAIL_ON_WARNING) {
-          (baton->err).append("Warning treated as error due to failOn setting");
-          baton->errUseWarning = true;
-        } else {
-          (baton->err).append("Unknown error");
-        }
-      }
+      AppendError(baton, err);
     }
-    // Clean up libvips' per-request data and threads
-    vips_error_clear();
-    vips_thread_shutdown();
+    baton->timeEnd = std::chrono::steady_clock::now();
+    baton->memoryEnd = vips_tracked_get_mem();
+    sharp::SampleMemory(&baton->memoryPeak);
+    if (progress) {
+      baton->memoryPeak = std::max(baton->memoryPeak, progress->memoryPeak.load());
+    }
+    baton->memoryMaterialised = sharp::threadMaterialised;
+    uint64_t const peak = baton->memoryPeak - baton->memoryStart;
+    uint64_t previous = sharp::counterMemoryPeak;
+    while (peak > previous && !sharp::counterMemoryPeak.compare_exchange_weak(previous, peak)) {}
   }
 
   void OnOK() {
     Napi::Env env = Env();
     Napi::HandleScope scope(env);
+    *completed = true;
+
+    // Identical tasks queued from now on can no longer attach to this one
+    Unlead();
 
     // Handle warnings
     std::string warning = sharp::VipsWarningPop();
@@ -1393,63 +1489,62 @@ class PipelineWorker : public Napi::AsyncWorker {
       warning = sharp::VipsWarningPop();
     }
     if (baton->err.empty()) {
-      int width = baton->width;
-      int height = baton->height;
-      if (baton->topOffsetPre != -1 && (baton->width == -1 || baton->height == -1)) {
-        width = baton->widthPre;
-        height = baton->heightPre;
-      }
-      if (baton->topOffsetPost != -1) {
-        width = baton->widthPost;
-        height = baton->heightPost;
-      }
-      // Info Object
-      Napi::Object info = Napi::Object::New(env);
-      info.Set("format", baton->formatOut);
-      info.Set("width", static_cast<uint32_t>(width));
-      info.Set("height", static_cast<uint32_t>(height));
-      info.Set("channels", static_cast<uint32_t>(baton->channels));
-      if (baton->formatOut == "raw") {
-        info.Set("depth", vips_enum_nick(VIPS_TYPE_BAND_FORMAT, baton->rawDepth));
-      }
-      info.Set("premultiplied", baton->premultiplied);
-      if (baton->hasCropOffset) {
-        info.Set("cropOffsetLeft", static_cast<int32_t>(baton->cropOffsetLeft));
-        info.Set("cropOffsetTop", static_cast<int32_t>(baton->cropOffsetTop));
-      }
-      if (baton->hasAttentionCenter) {
-        info.Set("attentionX", static_cast<int32_t>(baton->attentionX));
-        info.Set("attentionY", static_cast<int32_t>(baton->attentionY));
-      }
-      if (baton->trimThreshold >= 0.0) {
-        info.Set("trimOffsetLeft", static_cast<int32_t>(baton->trimOffsetLeft));
-        info.Set("trimOffsetTop", static_cast<int32_t>(baton->trimOffsetTop));
-      }
-      if (baton->input->textAutofitDpi) {
-        info.Set("textAutofitDpi", static_cast<uint32_t>(baton->input->textAutofitDpi));
-      }
-      if (baton->pageHeightOut) {
-        info.Set("pageHeight", static_cast<int32_t>(baton->pageHeightOut));
-        info.Set("pages", static_cast<int32_t>(baton->pagesOut));
-      }
-      info.Set("hasAlpha", baton->hasAlphaOut);
-
-      if (baton->bufferOutLength > 0) {
+      if (baton->explain) {
+        Callback().SHARP_CALLBACK_FN_NAME(Receiver().Value(), { env.Null(), CreatePlan(env, baton) });
+      } else if (!baton->fanOut.empty()) {
+        // Array of Objects containing data and info for each output
+        Napi::Array results = Napi::Array::New(env, baton->fanOut.size());
+        for (size_t i = 0; i < baton->fanOut.size(); i++) {
+          PipelineBaton *branch = baton->fanOut[i];
+          Napi::Object info = CreateInfo(env, branch);
+          info.Set("size", static_cast<uint32_t>(branch->bufferOutLength));
+          Napi::Object result = Napi::Object::New(env);
+          result.Set("data", CreateBufferOut(env, branch));
+          result.Set("info", info);
+          results.Set(i, result);
+        }
+        Callback().SHARP_CALLBACK_FN_NAME(Receiver().Value(), { env.Null(), results });
+      } else if (!baton->batch.empty()) {
+        // Array of Objects containing either data and info, or an error, for each input
+        Napi::Array results = Napi::Array::New(env, baton->batch.size());
+        for (size_t i = 0; i < baton->batch.size(); i++) {
+          PipelineBaton *item = baton->batch[i];
+          Napi::Object result = Napi::Object::New(env);
+          if (item->err.empty()) {
+            Napi::Object info = CreateInfo(env, item);
+            info.Set("size", static_cast<uint32_t>(item->bufferOutLength));
+            result.Set("data", CreateBufferOut(env, item));
+            result.Set("info", info);
+          } else {
+            result.Set("error", Napi::Error::New(env, sharp::TrimEnd(item->err)).Value());
+          }
+          results.Set(i, result);
+        }
+        Callback().SHARP_CALLBACK_FN_NAME(Receiver().Value(), { env.Null(), results });
+      } else if (baton->bufferOutLength > 0) {
+        Napi::Object info = CreateInfo(env, baton);
         info.Set("size", static_cast<uint32_t>(baton->bufferOutLength));
-        if (baton->typedArrayOut) {
-          // ECMAScript ArrayBuffer with Uint8Array view
-          Napi::TypedArrayOf<uint8_t> data = Napi::Buffer<char>::Copy(env,
-            static_cast<char*>(baton->bufferOut), baton->bufferOutLength);
-          sharp::FreeCallback(static_cast<char*>(baton->bufferOut), nullptr);
-          Callback().SHARP_CALLBACK_FN_NAME(Receiver().Value(), { env.Null(), data, info });
+        Napi::Value data = CreateBufferOut(env, baton);
+        for (Napi::FunctionReference &follower : followers) {
+          Napi::Object followerInfo = CreateInfo(env, baton);
+          followerInfo.Set("size", static_cast<uint32_t>(baton->bufferOutLength));
+          follower.SHARP_CALLBACK_FN_NAME(Receiver().Value(),
+            { env.Null(), ShareBufferOut(env, data.As<Napi::Buffer<char>>()), followerInfo });
+        }
+        if (abandoned) {
+          Callback().SHARP_CALLBACK_FN_NAME(Receiver().Value(),
+            { Napi::Error::New(env, "The operation was aborted").Value() });
         } else {
-          // Node.js Buffer
-          Napi::Buffer<char> data = Napi::Buffer<char>::NewOrCopy(env, static_cast<char*>(baton->bufferOut),
-            baton->bufferOutLength, sharp::FreeCallback);
           Callback().SHARP_CALLBACK_FN_NAME(Receiver().Value(), { env.Null(), data, info });
         }
+      } else if (baton->streamOut) {
+        // Incremental Stream output, all data has already been passed to the Readable side
+        Napi::Object info = CreateInfo(env, baton);
+        info.Set("size", static_cast<uint32_t>(baton->streamOut->Length()));
+        Callback().SHARP_CALLBACK_FN_NAME(Receiver().Value(), { env.Null(), env.Undefined(), info });
       } else {
         // Add file size to info
+        Napi::Object info = CreateInfo(env, baton);
         if (baton->formatOut != "dz" || sharp::IsDzZip(baton->fileOut)) {
           try {
             uint32_t const size = static_cast<uint32_t>(
@@ -1460,24 +1555,35 @@ class PipelineWorker : public Napi::AsyncWorker {
         Callback().SHARP_CALLBACK_FN_NAME(Receiver().Value(), { env.Null(), info });
       }
     } else {
+      if (baton->bufferOutLength > 0) {
+        g_free(baton->bufferOut);
+      }
+      for (PipelineBaton *branch : baton->fanOut) {
+        if (branch->bufferOutLength > 0) {
+          g_free(branch->bufferOut);
+        }
+      }
+      for (PipelineBaton *item : baton->batch) {
+        if (item->bufferOutLength > 0) {
+          g_free(item->bufferOut);
+        }
+      }
+      for (Napi::FunctionReference &follower : followers) {
+        follower.SHARP_CALLBACK_FN_NAME(Receiver().Value(),
+          { Napi::Error::New(env, sharp::TrimEnd(baton->err)).Value() });
+      }
       Callback().SHARP_CALLBACK_FN_NAME(Receiver().Value(),
         { Napi::Error::New(env, sharp::TrimEnd(baton->err)).Value() });
     }
 
     // Delete baton
-    delete baton->input;
-    delete baton->boolean;
-    for (Composite *composite : baton->composite) {
-      delete composite->input;
-      delete composite;
-    }
-    for (sharp::InputDescriptor *input : baton->joinChannelIn) {
-      delete input;
+    for (PipelineBaton *branch : baton->fanOut) {
+      DeleteBaton(branch);
     }
-    for (sharp::InputDescriptor *input : baton->join) {
-      delete input;
+    for (PipelineBaton *item : baton->batch) {
+      DeleteBaton(item);
     }
-    delete baton;
+    DeleteBaton(baton);
 
     // Decrement processing task counter
     sharp::counterProcess--;
@@ -1485,10 +1591,695 @@ class PipelineWorker : public Napi::AsyncWorker {
     queueListener.SHARP_CALLBACK_FN_NAME(Receiver().Value(), { queueLength });
   }
 
+  /*
+    Stop processing, called from the JS thread before the callback has been invoked.
+    Removes the task from the queue when it has yet to start, otherwise kills it at the next progress update.
+  */
+  void Abort() {
+    if (!followers.empty()) {
+      // Identical tasks are waiting for the result, so only the callback of this task is aborted
+      abandoned = true;
+      return;
+    }
+    Unlead();
+    *baton->aborted = true;
+    // Unblock any pending read or write of Stream-based input and output
+    if (baton->input->stream) {
+      baton->input->stream->End(true);
+    }
+    if (baton->streamOut) {
+      baton->streamOut->Destroy();
+    }
+    if (sharp::Scheduler::Instance().Cancel(this)) {
+      // Complete without starting, balancing the counters as Execute would have
+      sharp::counterQueue--;
+      sharp::counterProcess++;
+      baton->err = "The operation was aborted";
+      if (baton->streamOut) {
+        baton->streamOut->Finish(false);
+      }
+    }
+  }
+
+  /*
+    Allow identical tasks, with the given key, to attach to this one until it completes.
+  */
+  void Lead(std::string const &key) {
+    std::lock_guard<std::mutex> lock(inFlightMutex);
+    inFlight[key] = this;
+    coalesceKey = key;
+  }
+
+  /*
+    Find a queued or running task with the given key and attach the callback of an identical task to it,
+    to be called with the same result rather than processing again, taking ownership of its baton.
+  */
+  static bool Follow(std::string const &key, Napi::Function callback, PipelineBaton *baton) {
+    std::lock_guard<std::mutex> lock(inFlightMutex);
+    auto const leader = inFlight.find(key);
+    if (leader == inFlight.end()) {
+      return false;
+    }
+    leader->second->followers.push_back(Napi::Persistent(callback));
+    DeleteBaton(baton);
+    return true;
+  }
+
  private:
   PipelineBaton *baton;
   Napi::FunctionReference debuglog;
   Napi::FunctionReference queueListener;
+  std::shared_ptr<bool> completed;
+  std::string coalesceKey;
+  std::vector<Napi::FunctionReference> followers;
+  bool abandoned = false;
+
+  void Unlead() {
+    if (!coalesceKey.empty()) {
+      std::lock_guard<std::mutex> lock(inFlightMutex);
+      inFlight.erase(coalesceKey);
+      coalesceKey.clear();
+    }
+  }
+
+  /*
+    Decode the input once, shrinking on load only as far as the largest output allows,
+    then process each output from the same decoded image held in memory.
+  */
+  void FanOut() {
+    InputLevels const levels = GetInputLevels(baton->input);
+    try {
+      vips::VImage image;
+      sharp::ImageType inputImageType;
+      std::tie(image, inputImageType) = sharp::OpenInput(baton->input);
+
+      // When auto-rotating by 90 or 270 degrees, swap the target width and height
+      bool swapTarget = false;
+      if (baton->input->autoOrient) {
+        VipsAngle autoRotation;
+        bool autoFlop;
+        std::tie(autoRotation, autoFlop) = CalculateExifRotationAndFlop(sharp::ExifOrientation(image));
+        swapTarget = autoRotation == VIPS_ANGLE_D90 || autoRotation == VIPS_ANGLE_D270;
+      }
+      int const pageHeight = sharp::GetPageHeight(image);
+
+      int jpegShrinkOnLoad = 8;
+      double scale = 0.0;
+      double pyramidShrink = std::numeric_limits<double>::max();
+      for (PipelineBaton *branch : baton->fanOut) {
+        int const targetResizeWidth = swapTarget ? branch->height : branch->width;
+        int const targetResizeHeight = swapTarget ? branch->width : branch->height;
+        // As for a single output, also excluding any rotation before resize
+        bool const rotateBefore = branch->rotateBefore || branch->orientBefore;
+        if (!ShouldPreShrink(branch, targetResizeWidth, targetResizeHeight, rotateBefore)) {
+          jpegShrinkOnLoad = 1;
+          scale = 1.0;
+          pyramidShrink = 1.0;
+          break;
+        }
+        double hshrink;
+        double vshrink;
+        std::tie(hshrink, vshrink) = sharp::ResolveShrink(
+          image.width(), pageHeight, targetResizeWidth, targetResizeHeight,
+          branch->canvas, branch->withoutEnlargement, branch->withoutReduction);
+        int branchJpegShrinkOnLoad;
+        double branchScale;
+        std::tie(branchJpegShrinkOnLoad, branchScale) = CalculateShrinkOnLoad(inputImageType,
+          std::min(hshrink, vshrink), branch->fastShrinkOnLoad);
+        jpegShrinkOnLoad = std::min(jpegShrinkOnLoad, branchJpegShrinkOnLoad);
+        scale = std::max(scale, branchScale);
+        pyramidShrink = std::min(pyramidShrink, std::min(hshrink, vshrink));
+      }
+      // The pyramid level with enough pixels for the largest output
+      scale *= SelectPyramidLevel(image, inputImageType, baton->input, pyramidShrink);
+      image = ReloadWithShrinkOnLoad(image, inputImageType, baton->input, jpegShrinkOnLoad, scale);
+      image = sharp::SetConcurrency(image, baton->concurrency);
+      // Decode, once the whole image fits within the memory budget of the scheduler
+      if (!sharp::Scheduler::Instance().Admit(sharp::EstimateMemory(image, true))) {
+        Defer(baton, levels);
+        return;
+      }
+      image = sharp::CopyMemory(image);
+
+      for (PipelineBaton *branch : baton->fanOut) {
+        branch->decodedIn = image;
+        branch->decodedInType = inputImageType;
+        branch->decodedInShrink = jpegShrinkOnLoad;
+        branch->decodedInScale = scale;
+        Process(branch);
+        branch->decodedIn = vips::VImage();
+        if (!branch->err.empty()) {
+          baton->err = branch->err;
+          baton->errUseWarning = branch->errUseWarning;
+          break;
+        }
+      }
+    } catch (std::runtime_error const &err) {
+      AppendError(baton, err);
+    }
+  }
+
+  /*
+    Process the image described by baton, reusing the output of an identical task held by the result cache.
+  */
+  void ProcessCached(PipelineBaton *baton) {
+    std::string const key = TaskKey(baton, baton->resultKey, true);
+    sharp::ResultCache &results = sharp::ResultCache::Instance();
+    std::shared_ptr<std::string const> result;
+    if (!key.empty() && results.Get(key, &result) && UnpackResult(baton, *result)) {
+      // Nothing was opened or processed, so every stage ends as soon as it starts
+      baton->timeStart = baton->timeOpened = baton->timeOutput = baton->timeEnd = std::chrono::steady_clock::now();
+      baton->memoryStart = baton->memoryPeak = baton->memoryEnd = vips_tracked_get_mem();
+      return;
+    }
+    Process(baton);
+    if (!key.empty() && baton->err.empty() && baton->bufferOutLength > 0) {
+      results.Put(key, PackResult(baton));
+    }
+  }
+
+  /*
+    Serialise the properties of the output used by CreateInfo, followed by its data.
+  */
+  std::string PackResult(PipelineBaton *baton) {
+    std::ostringstream header;
+    header << baton->formatOut << " " << baton->width << " " << baton->height << " " << baton->channels << " "
+      << baton->premultiplied << " " << baton->hasCropOffset << " " << baton->cropOffsetLeft << " "
+      << baton->cropOffsetTop << " " << baton->hasAttentionCenter << " " << baton->attentionX << " "
+      << baton->attentionY << " " << baton->trimOffsetLeft << " " << baton->trimOffsetTop << " "
+      << baton->pageHeightOut << " " << baton->pagesOut << " " << baton->hasAlphaOut << " "
+      << baton->heightPost << " " << baton->iccSkipped << " " << baton->embeddedThumbnailUsed << "\n";
+    std::string result = header.str();
+    result.append(static_cast<char const*>(baton->bufferOut), baton->bufferOutLength);
+    return result;
+  }
+
+  /*
+    Restore the properties and data of an output serialised by PackResult.
+  */
+  bool UnpackResult(PipelineBaton *baton, std::string const &result) {
+    size_t const end = result.find('\n');
+    if (end == std::string::npos) {
+      return false;
+    }
+    std::istringstream header(result.substr(0, end));
+    header >> baton->formatOut >> baton->width >> baton->height >> baton->channels
+      >> baton->premultiplied >> baton->hasCropOffset >> baton->cropOffsetLeft
+      >> baton->cropOffsetTop >> baton->hasAttentionCenter >> baton->attentionX
+      >> baton->attentionY >> baton->trimOffsetLeft >> baton->trimOffsetTop
+      >> baton->pageHeightOut >> baton->pagesOut >> baton->hasAlphaOut
+      >> baton->heightPost >> baton->iccSkipped >> baton->embeddedThumbnailUsed;
+    if (header.fail()) {
+      return false;
+    }
+    baton->bufferOutLength = result.size() - end - 1;
+    baton->bufferOut = g_malloc(baton->bufferOutLength);
+    memcpy(baton->bufferOut, result.data() + end + 1, baton->bufferOutLength);
+    return true;
+  }
+
+  /*
+    Try to reload input using shrink-on-load for JPEG, WebP, SVG and PDF,
+    or a reduced level of pyramidal TIFF, OpenSlide and JPEG 2000, when:
+     - the width or height parameters are specified;
+     - gamma correction doesn't need to be applied;
+     - trimming or pre-resize extract isn't required;
+     - gain map processing is not required;
+     - input colourspace is not specified;
+     - input has not already been decoded;
+     - there is no rotation before resize.
+    PNG is always decoded at full resolution, libvips cannot decode only the early passes of Adam7 interlacing.
+  */
+  bool ShouldPreShrink(PipelineBaton *baton, int const targetResizeWidth, int const targetResizeHeight,
+    bool const rotateBefore) {
+    return (targetResizeWidth > 0 || targetResizeHeight > 0) &&
+      baton->gamma == 0 && baton->topOffsetPre == -1 && baton->trimThreshold < 0.0 &&
+      !baton->keepGainMap && !baton->withGainMap &&
+      baton->colourspacePipeline == VIPS_INTERPRETATION_LAST && !rotateBefore &&
+      baton->decodedIn.is_null();
+  }
+
+  // Levels of an input selected by shrink-on-load, restored when a task is deferred to start again
+  struct InputLevels {
+    int tiffSubifd;
+    int page;
+    int openSlideLevel;
+  };
+
+  InputLevels GetInputLevels(sharp::InputDescriptor const *input) {
+    return { input->tiffSubifd, input->page, input->openSlideLevel };
+  }
+
+  /*
+    Reserve the estimated working set of the image to process from the memory budget of the scheduler,
+    assuming the whole image is held in memory when decoding is not, or will not remain, sequential.
+    Returns false when the task must return, to be queued again until the estimate fits.
+  */
+  bool Admit(PipelineBaton *baton, VImage image, sharp::ImageType const imageType, int const nPages,
+    VipsAngle const autoRotation, VipsAngle const rotation) {
+    if (!baton->decodedIn.is_null()) {
+      // Held by fan-out
+      return true;
+    }
+    bool const inMemory = !vips_image_is_sequential(image.get_image()) ||
+      !RandomAccessOperations(baton, nPages, autoRotation, rotation, MayBeOpaque(image, imageType)).empty();
+    return sharp::Scheduler::Instance().Admit(sharp::EstimateMemory(image, inMemory));
+  }
+
+  /*
+    Return without processing, undoing the choices made from the header so the task can start again.
+  */
+  void Defer(PipelineBaton *baton, InputLevels const &levels) {
+    baton->deferred = true;
+    baton->input->tiffSubifd = levels.tiffSubifd;
+    baton->input->page = levels.page;
+    baton->input->openSlideLevel = levels.openSlideLevel;
+    baton->embeddedThumbnailUsed = false;
+  }
+
+  /*
+    Whether an image might have a fully opaque alpha channel, using hints from its loader before any scan of its pixels.
+    A palette-based PNG image only has an alpha channel when its tRNS chunk makes some of its palette transparent.
+  */
+  bool MayBeOpaque(VImage image, sharp::ImageType const imageType) {
+    bool const isPalette = image.get_typeof(VIPS_META_PALETTE) == G_TYPE_INT && image.get_int(VIPS_META_PALETTE);
+    return image.has_alpha() && !(imageType == sharp::ImageType::PNG && isPalette);
+  }
+
+  /*
+    Whether to scan for, and remove, a fully opaque alpha channel before operations that would premultiply it.
+  */
+  bool ShouldRemoveAlphaIfOpaque(PipelineBaton *baton, VImage image, sharp::ImageType const imageType,
+    bool const premultiplies) {
+    return baton->removeAlphaIfOpaque && premultiplies && !baton->flatten && baton->composite.empty() &&
+      MayBeOpaque(image, imageType);
+  }
+
+  /*
+    The embedded thumbnail of the input, when it has the same aspect ratio as the image and enough pixels
+    for the given shrink, otherwise a null image.
+  */
+  VImage SuitableEmbeddedThumbnail(VImage image, sharp::ImageType const imageType, sharp::InputDescriptor *input,
+    double const shrink) {
+    VImage thumbnail = sharp::OpenEmbeddedThumbnail(image, imageType, input);
+    if (!thumbnail.is_null() && thumbnail.width() * shrink >= image.width() &&
+      std::abs(static_cast<int64_t>(thumbnail.height()) * image.width() -
+        static_cast<int64_t>(image.height()) * thumbnail.width()) <= image.width()) {
+      return thumbnail;
+    }
+    return VImage();
+  }
+
+  /*
+    Names of the operations that require random access to pixels,
+    which decode the whole image into memory when the input is read sequentially.
+  */
+  std::vector<std::string> RandomAccessOperations(PipelineBaton *baton, int const nPages,
+    VipsAngle const autoRotation, VipsAngle const rotation, bool const mayBeOpaque) {
+    std::vector<std::string> operations;
+    if (autoRotation != VIPS_ANGLE_D0) {
+      operations.push_back("autoOrient");
+    }
+    if (rotation != VIPS_ANGLE_D0 || baton->rotationAngle != 0.0) {
+      operations.push_back("rotate");
+    }
+    if (baton->flip) {
+      operations.push_back("flip");
+    }
+    if (baton->trimThreshold >= 0.0) {
+      operations.push_back("trim");
+    }
+    // As for Process, only when it would otherwise premultiply, assuming any width or height requires a resize
+    bool const mayPremultiply = baton->width > 0 || baton->height > 0 || baton->blurSigma != 0.0 ||
+      baton->convKernelWidth * baton->convKernelHeight > 0 || baton->sharpenSigma != 0.0;
+    if (baton->removeAlphaIfOpaque && mayBeOpaque && mayPremultiply && !baton->flatten && baton->composite.empty()) {
+      operations.push_back("removeAlpha");
+    }
+    if (baton->canvas == sharp::Canvas::CROP && baton->position >= 9) {
+      operations.push_back(baton->position == 16 ? "entropy" : "attention");
+    }
+    if (!baton->affineMatrix.empty()) {
+      operations.push_back("affine");
+    }
+    if ((baton->extendTop > 0 || baton->extendBottom > 0 || baton->extendLeft > 0 || baton->extendRight > 0) &&
+      (nPages > 1 || baton->extendWith != VIPS_EXTEND_BACKGROUND)) {
+      operations.push_back("extend");
+    }
+    if (baton->normalise) {
+      operations.push_back("normalise");
+    }
+    if (baton->claheWidth != 0 && baton->claheHeight != 0) {
+      operations.push_back("clahe");
+    }
+    return operations;
+  }
+
+  /*
+    Resolve the plan for processing the image described by baton, reading only the header of the input.
+    Decisions that depend on pixel values, e.g. the bounding box found by trim, are not resolved.
+  */
+  void Explain(PipelineBaton *baton) {
+    try {
+      if (!baton->join.empty()) {
+        throw std::runtime_error("Cannot explain joined images");
+      }
+      PipelinePlan &plan = baton->plan;
+      vips::VImage image;
+      sharp::ImageType inputImageType;
+      std::tie(image, inputImageType) = sharp::OpenInput(baton->input);
+      plan.format = sharp::ImageTypeId(inputImageType);
+      plan.width = image.width();
+      plan.height = image.height();
+      plan.channels = image.bands();
+      plan.sequential = vips_image_is_sequential(image.get_image());
+
+      int nPages = baton->input->pages;
+      if (nPages == -1) {
+        nPages = image.get_typeof(VIPS_META_N_PAGES) != 0
+          ? image.get_int(VIPS_META_N_PAGES) - std::max(0, baton->input->page)
+          : 1;
+      }
+      plan.pages = nPages;
+      int pageHeight = sharp::GetPageHeight(image);
+
+      // As for Process
+      VipsAngle autoRotation = VIPS_ANGLE_D0;
+      bool autoFlop = false;
+      if (baton->input->autoOrient) {
+        std::tie(autoRotation, autoFlop) = CalculateExifRotationAndFlop(sharp::ExifOrientation(image));
+      }
+      VipsAngle rotation = CalculateAngleRotation(baton->angle);
+      bool const shouldRotateBefore = baton->rotateBefore &&
+        (rotation != VIPS_ANGLE_D0 || baton->flip || baton->flop || baton->rotationAngle != 0.0);
+      bool const shouldOrientBefore = (shouldRotateBefore || baton->orientBefore) &&
+        (autoRotation != VIPS_ANGLE_D0 || autoFlop);
+      plan.randomAccess = RandomAccessOperations(baton, nPages, autoRotation, rotation,
+        MayBeOpaque(image, inputImageType));
+
+      // Dimensions before resize, swapped by any rotation of 90 or 270 degrees before resize
+      auto const swapsDimensions = [](VipsAngle angle) {
+        return angle == VIPS_ANGLE_D90 || angle == VIPS_ANGLE_D270;
+      };
+      int inputWidth = image.width();
+      int inputHeight = image.height();
+      if (shouldOrientBefore && swapsDimensions(autoRotation)) {
+        std::swap(inputWidth, inputHeight);
+      }
+      if (shouldRotateBefore && swapsDimensions(rotation)) {
+        std::swap(inputWidth, inputHeight);
+      }
+      if (baton->topOffsetPre != -1) {
+        inputWidth = baton->widthPre;
+        inputHeight = baton->heightPre;
+        pageHeight = baton->heightPre;
+      }
+      if (nPages == 1) {
+        pageHeight = inputHeight;
+      }
+      int targetResizeWidth = baton->width;
+      int targetResizeHeight = baton->height;
+      if (!shouldOrientBefore && swapsDimensions(autoRotation)) {
+        std::swap(targetResizeWidth, targetResizeHeight);
+      }
+      double hshrink;
+      double vshrink;
+      std::tie(hshrink, vshrink) = sharp::ResolveShrink(
+        inputWidth, pageHeight, targetResizeWidth, targetResizeHeight,
+        baton->canvas, baton->withoutEnlargement, baton->withoutReduction);
+
+      // Shrink-on-load, reloading only the header
+      if (ShouldPreShrink(baton, targetResizeWidth, targetResizeHeight, shouldOrientBefore || shouldRotateBefore)) {
+        std::tie(plan.shrinkOnLoad, plan.scaleOnLoad) = CalculateShrinkOnLoad(inputImageType,
+          std::min(hshrink, vshrink), baton->fastShrinkOnLoad);
+        plan.scaleOnLoad *= SelectPyramidLevel(image, inputImageType, baton->input, std::min(hshrink, vshrink));
+        VImage thumbnail;
+        if (baton->input->embeddedThumbnail) {
+          thumbnail = SuitableEmbeddedThumbnail(image, inputImageType, baton->input, std::min(hshrink, vshrink));
+        }
+        if (!thumbnail.is_null()) {
+          plan.shrinkOnLoad = 1;
+          plan.scaleOnLoad = static_cast<double>(thumbnail.width()) / image.width();
+          image = thumbnail;
+        } else {
+          image = ReloadWithShrinkOnLoad(image, inputImageType, baton->input, plan.shrinkOnLoad, plan.scaleOnLoad);
+        }
+        inputWidth = image.width();
+        inputHeight = image.height();
+        pageHeight = sharp::GetPageHeight(image);
+        std::tie(hshrink, vshrink) = sharp::ResolveShrink(
+          inputWidth, pageHeight, targetResizeWidth, targetResizeHeight,
+          baton->canvas, baton->withoutEnlargement, baton->withoutReduction);
+      }
+      plan.widthOnLoad = inputWidth;
+      plan.heightOnLoad = inputHeight;
+      if (inputHeight > pageHeight) {
+        vshrink = static_cast<double>(inputHeight) /
+          (static_cast<int>(std::rint(static_cast<double>(pageHeight) / vshrink)) * nPages);
+      }
+      plan.hshrink = hshrink;
+      plan.vshrink = vshrink;
+
+      bool const shouldResize = hshrink != 1.0 || vshrink != 1.0;
+      bool const shouldBlur = baton->blurSigma != 0.0;
+      bool const shouldConv = baton->convKernelWidth * baton->convKernelHeight > 0;
+      bool const shouldSharpen = baton->sharpenSigma != 0.0;
+      bool const premultiplies = shouldResize || shouldBlur || shouldConv || shouldSharpen;
+      bool const hasAlpha = !baton->composite.empty() || (image.has_alpha() && !baton->flatten);
+      // An alpha channel that may be fully opaque is only premultiplied when its pixels show it is not
+      bool const mayRemoveAlpha = ShouldRemoveAlphaIfOpaque(baton, image, inputImageType, premultiplies);
+      plan.premultiply = hasAlpha && premultiplies && !mayRemoveAlpha;
+
+      // Operations, in the order they are applied
+      auto const add = [&plan](bool const condition, char const *name) {
+        if (condition) {
+          plan.operations.push_back(name);
+        }
+      };
+      bool const orient = autoRotation != VIPS_ANGLE_D0 || autoFlop;
+      bool const rotate = rotation != VIPS_ANGLE_D0 || baton->rotationAngle != 0.0;
+      add(shouldOrientBefore && orient, "autoOrient");
+      add(shouldRotateBefore && baton->flip, "flip");
+      add(shouldRotateBefore && baton->flop, "flop");
+      add(shouldRotateBefore && rotate, "rotate");
+      add(baton->trimThreshold >= 0.0, "trim");
+      add(baton->topOffsetPre != -1, "extract");
+      add(baton->flatten && image.has_alpha(), "flatten");
+      add(baton->gamma >= 1 && baton->gamma <= 3, "gamma");
+      add(baton->greyscale, "greyscale");
+      add(mayRemoveAlpha, "removeAlpha");
+      add(shouldResize || (baton->canvas == sharp::Canvas::CROP && baton->position >= 9), "resize");
+      add(!shouldOrientBefore && orient, "autoOrient");
+      add(!shouldRotateBefore && baton->flip, "flip");
+      add(!shouldRotateBefore && baton->flop, "flop");
+      add(!shouldRotateBefore && rotate, "rotate");
+      add(!baton->joinChannelIn.empty(), "joinChannel");
+      add(baton->topOffsetPost != -1, "extract");
+      add(!baton->affineMatrix.empty(), "affine");
+      add(baton->extendTop > 0 || baton->extendBottom > 0 || baton->extendLeft > 0 || baton->extendRight > 0,
+        "extend");
+      add(baton->medianSize > 0, "median");
+      add(baton->threshold != 0, "threshold");
+      add(baton->dilateWidth != 0, "dilate");
+      add(baton->erodeWidth != 0, "erode");
+      add(shouldBlur, "blur");
+      add(baton->unflatten, "unflatten");
+      add(shouldConv, "convolve");
+      add(!baton->recombMatrix.empty(), "recomb");
+      add(baton->brightness != 1.0 || baton->saturation != 1.0 || baton->hue != 0.0 || baton->lightness != 0.0,
+        "modulate");
+      add(shouldSharpen, "sharpen");
+      add(!baton->composite.empty(), "composite");
+      add(baton->gammaOut >= 1 && baton->gammaOut <= 3, "gamma");
+      add(!baton->linearA.empty(), "linear");
+      add(baton->normalise, "normalise");
+      add(baton->claheWidth != 0 && baton->claheHeight != 0, "clahe");
+      add(baton->boolean != nullptr, "boolean");
+      add(baton->bandBoolOp >= VIPS_OPERATION_BOOLEAN_AND && baton->bandBoolOp < VIPS_OPERATION_BOOLEAN_LAST,
+        "bandbool");
+      add(baton->tint[0] >= 0.0, "tint");
+      add(baton->removeAlpha, "removeAlpha");
+      add(baton->ensureAlpha != -1, "ensureAlpha");
+      add(baton->extractChannel > -1, "extractChannel");
+      add(!baton->withIccProfile.empty(), "withIccProfile");
+      add(baton->negate, "negate");
+    } catch (std::runtime_error const &err) {
+      AppendError(baton, err);
+    }
+  }
+
+  /*
+    Append the message of an exception to baton->err, using any libvips warnings when empty.
+  */
+  void AppendError(PipelineBaton *baton, std::runtime_error const &err) {
+    char const *what = err.what();
+    if (what && what[0]) {
+      (baton->err).append(what);
+    } else {
+      if (baton->input->failOn == VIPS_FAIL_ON_WARNING) {
+        (baton->err).append("Warning treated as error due to failOn setting");
+        baton->errUseWarning = true;
+      } else {
+        (baton->err).append("Unknown error");
+      }
+    }
+  }
+
+  /*
+    Create an Object describing the resolved plan for processing the input image.
+  */
+  Napi::Object CreatePlan(Napi::Env env, PipelineBaton *baton) {
+    PipelinePlan const &plan = baton->plan;
+    auto const toArray = [&env](std::vector<std::string> const &names) {
+      Napi::Array array = Napi::Array::New(env, names.size());
+      for (size_t i = 0; i < names.size(); i++) {
+        array.Set(i, names[i]);
+      }
+      return array;
+    };
+    Napi::Object input = Napi::Object::New(env);
+    input.Set("format", plan.format);
+    input.Set("width", static_cast<uint32_t>(plan.width));
+    input.Set("height", static_cast<uint32_t>(plan.height));
+    input.Set("channels", static_cast<uint32_t>(plan.channels));
+    input.Set("pages", static_cast<uint32_t>(plan.pages));
+    input.Set("sequential", plan.sequential);
+    Napi::Object shrinkOnLoad = Napi::Object::New(env);
+    shrinkOnLoad.Set("shrink", static_cast<uint32_t>(plan.shrinkOnLoad));
+    shrinkOnLoad.Set("scale", plan.scaleOnLoad);
+    shrinkOnLoad.Set("width", static_cast<uint32_t>(plan.widthOnLoad));
+    shrinkOnLoad.Set("height", static_cast<uint32_t>(plan.heightOnLoad));
+    Napi::Object resize = Napi::Object::New(env);
+    resize.Set("hshrink", plan.hshrink);
+    resize.Set("vshrink", plan.vshrink);
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("input", input);
+    result.Set("shrinkOnLoad", shrinkOnLoad);
+    result.Set("resize", resize);
+    result.Set("premultiply", plan.premultiply);
+    result.Set("operations", toArray(plan.operations));
+    result.Set("randomAccess", toArray(plan.randomAccess));
+    return result;
+  }
+
+  /*
+    Create an Object describing the output image.
+  */
+  Napi::Object CreateInfo(Napi::Env env, PipelineBaton *baton) {
+    int width = baton->width;
+    int height = baton->height;
+    if (baton->topOffsetPre != -1 && (baton->width == -1 || baton->height == -1)) {
+      width = baton->widthPre;
+      height = baton->heightPre;
+    }
+    if (baton->topOffsetPost != -1) {
+      width = baton->widthPost;
+      height = baton->heightPost;
+    }
+    // Info Object
+    Napi::Object info = Napi::Object::New(env);
+    info.Set("format", baton->formatOut);
+    info.Set("width", static_cast<uint32_t>(width));
+    info.Set("height", static_cast<uint32_t>(height));
+    info.Set("channels", static_cast<uint32_t>(baton->channels));
+    if (baton->formatOut == "raw") {
+      info.Set("depth", vips_enum_nick(VIPS_TYPE_BAND_FORMAT, baton->rawDepth));
+    }
+    info.Set("premultiplied", baton->premultiplied);
+    if (baton->hasCropOffset) {
+      info.Set("cropOffsetLeft", static_cast<int32_t>(baton->cropOffsetLeft));
+      info.Set("cropOffsetTop", static_cast<int32_t>(baton->cropOffsetTop));
+    }
+    if (baton->hasAttentionCenter) {
+      info.Set("attentionX", static_cast<int32_t>(baton->attentionX));
+      info.Set("attentionY", static_cast<int32_t>(baton->attentionY));
+    }
+    if (baton->trimThreshold >= 0.0) {
+      info.Set("trimOffsetLeft", static_cast<int32_t>(baton->trimOffsetLeft));
+      info.Set("trimOffsetTop", static_cast<int32_t>(baton->trimOffsetTop));
+    }
+    if (baton->input->textAutofitDpi) {
+      info.Set("textAutofitDpi", static_cast<uint32_t>(baton->input->textAutofitDpi));
+    }
+    if (baton->pageHeightOut) {
+      info.Set("pageHeight", static_cast<int32_t>(baton->pageHeightOut));
+      info.Set("pages", static_cast<int32_t>(baton->pagesOut));
+    }
+    info.Set("hasAlpha", baton->hasAlphaOut);
+    if (baton->input->skipStandardIcc) {
+      info.Set("iccSkipped", baton->iccSkipped);
+    }
+    if (baton->input->embeddedThumbnail) {
+      info.Set("embeddedThumbnail", baton->embeddedThumbnailUsed);
+    }
+    if (baton->concurrencyOut > 0) {
+      info.Set("concurrency", baton->concurrencyOut);
+    }
+    if (baton->timings) {
+      // Milliseconds spent in each stage
+      auto const ms = [](std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+      };
+      Napi::Object timings = Napi::Object::New(env);
+      timings.Set("queue", ms(baton->timeQueued, baton->timeStart));
+      timings.Set("open", ms(baton->timeStart, baton->timeOpened));
+      timings.Set("pipeline", ms(baton->timeOpened, baton->timeOutput));
+      timings.Set("output", ms(baton->timeOutput, baton->timeEnd));
+      timings.Set("total", ms(baton->timeQueued, baton->timeEnd));
+      info.Set("timings", timings);
+    }
+    // Memory used, in bytes
+    Napi::Object memory = Napi::Object::New(env);
+    memory.Set("delta", static_cast<double>(static_cast<int64_t>(baton->memoryEnd) -
+      static_cast<int64_t>(baton->memoryStart)));
+    memory.Set("peak", static_cast<double>(baton->memoryPeak - baton->memoryStart));
+    memory.Set("materialised", static_cast<double>(baton->memoryMaterialised));
+    info.Set("memory", memory);
+    return info;
+  }
+
+  /*
+    Create a Buffer or Uint8Array that takes ownership of the output data.
+  */
+  Napi::Value CreateBufferOut(Napi::Env env, PipelineBaton *baton) {
+    napi_value externalArrayBuffer = nullptr;
+    if (baton->typedArrayOut && !baton->typedArrayTransferable) {
+      // Pass ownership of memory allocated by libvips to an external, and therefore non-transferable,
+      // ArrayBuffer, falling back to a copy where the runtime does not allow external memory
+      if (napi_create_external_arraybuffer(env, baton->bufferOut, baton->bufferOutLength,
+        [](napi_env, void *data, void*) { g_free(data); }, nullptr, &externalArrayBuffer) != napi_ok) {
+        externalArrayBuffer = nullptr;
+        if (env.IsExceptionPending()) {
+          env.GetAndClearPendingException();
+        }
+      }
+    }
+    if (externalArrayBuffer != nullptr) {
+      // ECMAScript external ArrayBuffer with Uint8Array view
+      Napi::Uint8Array data = Napi::Uint8Array::New(env, baton->bufferOutLength,
+        Napi::ArrayBuffer(env, externalArrayBuffer), 0);
+      return data;
+    } else if (baton->typedArrayOut) {
+      // ECMAScript ArrayBuffer with Uint8Array view
+      Napi::TypedArrayOf<uint8_t> data = Napi::Buffer<char>::Copy(env,
+        static_cast<char*>(baton->bufferOut), baton->bufferOutLength);
+      sharp::FreeCallback(static_cast<char*>(baton->bufferOut), nullptr);
+      return data;
+    } else {
+      // Node.js Buffer
+      Napi::Buffer<char> data = Napi::Buffer<char>::NewOrCopy(env, static_cast<char*>(baton->bufferOut),
+        baton->bufferOutLength, sharp::FreeCallback);
+      return data;
+    }
+  }
+
+  /*
+    Create a Buffer that shares the memory of another, keeping it alive for as long as the new Buffer.
+  */
+  Napi::Value ShareBufferOut(Napi::Env env, Napi::Buffer<char> data) {
+    Napi::Reference<Napi::Buffer<char>> *owner = new Napi::Reference<Napi::Buffer<char>>(Napi::Persistent(data));
+    return Napi::Buffer<char>::NewOrCopy(env, data.Data(), data.Length(),
+      [](Napi::Env, char*, Napi::Reference<Napi::Buffer<char>> *owner) { delete owner; }, owner);
+  }
 
   void MultiPageUnsupported(int const pages, std::string op) {
     if (pages > 1) {
@@ -1544,6 +2335,192 @@ class PipelineWorker : public Napi::AsyncWorker {
     alongside comma-separated arguments to the corresponding `formatsave` vips
     action.
   */
+  /*
+    Calculate the integer shrink factor for jpegload* or the
+    scale factor for webpload*, pdfload* and svgload*
+  */
+  std::tuple<int, double>
+  CalculateShrinkOnLoad(sharp::ImageType const inputImageType, double const shrink, bool const fastShrinkOnLoad) {
+    int jpegShrinkOnLoad = 1;
+    double scale = 1.0;
+    if (inputImageType == sharp::ImageType::JPEG) {
+      // Leave at least a factor of two for the final resize step, when fastShrinkOnLoad: false
+      // for more consistent results and to avoid extra sharpness to the image
+      int factor = fastShrinkOnLoad ? 1 : 2;
+      if (shrink >= 8 * factor) {
+        jpegShrinkOnLoad = 8;
+      } else if (shrink >= 4 * factor) {
+        jpegShrinkOnLoad = 4;
+      } else if (shrink >= 2 * factor) {
+        jpegShrinkOnLoad = 2;
+      }
+      // Lower shrink-on-load for known libjpeg rounding errors
+      if (jpegShrinkOnLoad > 1 && static_cast<int>(shrink) == jpegShrinkOnLoad) {
+        jpegShrinkOnLoad /= 2;
+      }
+    } else if (inputImageType == sharp::ImageType::WEBP && fastShrinkOnLoad && shrink > 1.0) {
+      // Avoid upscaling via webp
+      scale = 1.0 / shrink;
+    } else if (inputImageType == sharp::ImageType::SVG ||
+               inputImageType == sharp::ImageType::PDF) {
+      scale = 1.0 / shrink;
+    }
+    return std::make_tuple(jpegShrinkOnLoad, scale);
+  }
+
+  /*
+    Select the smallest level of a pyramidal TIFF, stored as sub-IFDs or pages, of an OpenSlide image
+    or of the wavelet resolutions of a JPEG 2000 image, that is reduced by no more than the given shrink,
+    unless a level was requested.
+    Updates the input to load the selected level, returning its scale relative to the full resolution image.
+  */
+  double SelectPyramidLevel(VImage image, sharp::ImageType const inputImageType, sharp::InputDescriptor *input,
+    double const shrink) {
+    int const width = image.width();
+    int selected = -1;
+    int selectedWidth = width;
+    bool const hasSubifds = image.get_typeof(VIPS_META_N_SUBIFDS) == G_TYPE_INT &&
+      image.get_int(VIPS_META_N_SUBIFDS) > 0;
+    if (inputImageType == sharp::ImageType::TIFF && input->tiffSubifd == -1 && hasSubifds) {
+      int const subifds = image.get_int(VIPS_META_N_SUBIFDS);
+      for (int subifd = 0; subifd < subifds; subifd++) {
+        // Reads only the header of each sub-IFD
+        input->tiffSubifd = subifd;
+        VImage level;
+        std::tie(level, std::ignore) = sharp::OpenInput(input);
+        if (level.width() < selectedWidth && level.width() * shrink >= width) {
+          selected = subifd;
+          selectedWidth = level.width();
+        }
+      }
+      input->tiffSubifd = selected;
+    } else if (inputImageType == sharp::ImageType::OPENSLIDE && input->openSlideLevel == -1 &&
+      image.get_typeof("openslide.level-count") == VIPS_TYPE_REF_STRING) {
+      // Properties are strings from the slide, any that are not a positive integer are ignored
+      auto const property = [&image](std::string const &name) -> int {
+        if (image.get_typeof(name.data()) != VIPS_TYPE_REF_STRING) {
+          return 0;
+        }
+        char const *value = image.get_string(name.data());
+        char *end = nullptr;
+        gint64 const number = g_ascii_strtoll(value, &end, 10);
+        return end != value && *end == '\0' && number > 0 && number <= G_MAXINT ? static_cast<int>(number) : 0;
+      };
+      int const levels = property("openslide.level-count");
+      for (int l = 1; l < levels; l++) {
+        int const levelWidth = property("openslide.level[" + std::to_string(l) + "].width");
+        if (levelWidth > 0 && levelWidth < selectedWidth && levelWidth * shrink >= width) {
+          selected = l;
+          selectedWidth = levelWidth;
+        }
+      }
+      input->openSlideLevel = selected;
+    } else if ((inputImageType == sharp::ImageType::JP2 || inputImageType == sharp::ImageType::TIFF) &&
+      input->page == -1 && input->pages == 1 && image.get_typeof(VIPS_META_N_PAGES) == G_TYPE_INT) {
+      // Each page is a resolution half the size of the previous, as written by tiffsave with pyramid
+      int const pages = image.get_int(VIPS_META_N_PAGES);
+      int previousWidth = width;
+      int previousHeight = image.height();
+      for (int page = 1; page < pages && (1 << page) <= shrink; page++) {
+        input->page = page;
+        VImage level;
+        std::tie(level, std::ignore) = sharp::OpenInput(input);
+        if (std::abs(level.width() - previousWidth / 2) > 1 || std::abs(level.height() - previousHeight / 2) > 1) {
+          // Pages of a multi-page TIFF that is not a pyramid
+          break;
+        }
+        previousWidth = level.width();
+        previousHeight = level.height();
+        if (level.width() * shrink >= width) {
+          selected = page;
+          selectedWidth = level.width();
+        }
+      }
+      input->page = selected;
+    }
+    return static_cast<double>(selectedWidth) / width;
+  }
+
+  /*
+    Reload input using shrink-on-load, it'll be an integer shrink
+    factor for jpegload*, a double scale factor for webpload*,
+    pdfload* and svgload*, or a level of a pyramidal TIFF, OpenSlide or JPEG 2000 image
+  */
+  VImage ReloadWithShrinkOnLoad(VImage image, sharp::ImageType const inputImageType, sharp::InputDescriptor *input,
+    int const jpegShrinkOnLoad, double const scale) {
+    if (jpegShrinkOnLoad > 1) {
+      vips::VOption *option = GetOptionsForImageType(inputImageType, input)->set("shrink", jpegShrinkOnLoad);
+      if (input->stream) {
+        // Reload JPEG stream, libvips retains the data read so far
+        image = VImage::jpegload_source(input->stream->Source(), option);
+      } else if (input->buffer != nullptr) {
+        // Reload JPEG buffer
+        VipsBlob *blob = vips_blob_new(nullptr, input->buffer, input->bufferLength);
+        image = VImage::jpegload_buffer(blob, option);
+        vips_area_unref(reinterpret_cast<VipsArea*>(blob));
+      } else {
+        // Reload JPEG file
+        image = VImage::jpegload(const_cast<char*>(input->file.data()), option);
+      }
+    } else if (scale != 1.0) {
+      vips::VOption *option = GetOptionsForImageType(inputImageType, input)->set("scale", scale);
+      if (inputImageType == sharp::ImageType::WEBP) {
+        if (input->stream) {
+          // Reload WebP stream
+          image = VImage::webpload_source(input->stream->Source(), option);
+        } else if (input->buffer != nullptr) {
+          // Reload WebP buffer
+          VipsBlob *blob = vips_blob_new(nullptr, input->buffer, input->bufferLength);
+          image = VImage::webpload_buffer(blob, option);
+          vips_area_unref(reinterpret_cast<VipsArea*>(blob));
+        } else {
+          // Reload WebP file
+          image = VImage::webpload(const_cast<char*>(input->file.data()), option);
+        }
+      } else if (inputImageType == sharp::ImageType::SVG) {
+        if (input->stream) {
+          // Reload SVG stream
+          image = VImage::svgload_source(input->stream->Source(), option);
+        } else if (input->buffer != nullptr) {
+          // Reload SVG buffer
+          VipsBlob *blob = vips_blob_new(nullptr, input->buffer, input->bufferLength);
+          image = VImage::svgload_buffer(blob, option);
+          vips_area_unref(reinterpret_cast<VipsArea*>(blob));
+        } else {
+          // Reload SVG file
+          image = VImage::svgload(const_cast<char*>(input->file.data()), option);
+        }
+        sharp::SetDensity(image, input->density);
+        if (image.width() > 32767 || image.height() > 32767) {
+          throw std::runtime_error("Input SVG image will exceed 32767x32767 pixel limit when scaled");
+        }
+      } else if (inputImageType == sharp::ImageType::PDF) {
+        if (input->stream) {
+          // Reload PDF stream
+          image = VImage::pdfload_source(input->stream->Source(), option);
+        } else if (input->buffer != nullptr) {
+          // Reload PDF buffer
+          VipsBlob *blob = vips_blob_new(nullptr, input->buffer, input->bufferLength);
+          image = VImage::pdfload_buffer(blob, option);
+          vips_area_unref(reinterpret_cast<VipsArea*>(blob));
+        } else {
+          // Reload PDF file
+          image = VImage::pdfload(const_cast<char*>(input->file.data()), option);
+        }
+        sharp::SetDensity(image, input->density);
+      } else if (inputImageType == sharp::ImageType::TIFF || inputImageType == sharp::ImageType::OPENSLIDE ||
+                 inputImageType == sharp::ImageType::JP2) {
+        // Reload at the level selected by SelectPyramidLevel
+        std::tie(image, std::ignore) = sharp::OpenInput(input);
+      }
+    } else {
+      if (inputImageType == sharp::ImageType::SVG && (image.width() > 32767 || image.height() > 32767)) {
+        throw std::runtime_error("Input SVG image exceeds 32767x32767 pixel limit");
+      }
+    }
+    return image;
+  }
+
   std::string
   AssembleSuffixString(std::string extname, std::vector<std::pair<std::string, std::string>> options) {
     std::string argument;
@@ -1636,22 +2613,34 @@ class PipelineWorker : public Napi::AsyncWorker {
   }
 
   /*
-    Clear all thread-local data.
+    Write image to a Buffer using the named saver, or when Stream output is incremental
+    and the saver supports it, to a target that passes each chunk to the Readable side.
+    TIFF requires a seekable target and DZ uses a zip container, so both remain buffered.
   */
-  void Error() {
-    // Clean up libvips' per-request data and threads
-    vips_error_clear();
-    vips_thread_shutdown();
+  void SaveBuffer(VImage image, std::string const &saver, vips::VOption *options, PipelineBaton *baton) {
+    if (baton->streamOut && saver != "tiff" && saver != "dz" && saver != "uhdr") {
+      VImage::call((saver + "save_target").data(), options
+        ->set("in", image)
+        ->set("target", baton->streamOut->Target()));
+    } else {
+      VipsBlob *blob;
+      VImage::call((saver + "save_buffer").data(), options
+        ->set("in", image)
+        ->set("buffer", &blob));
+      VipsArea *area = reinterpret_cast<VipsArea*>(blob);
+      baton->bufferOut = static_cast<char*>(area->data);
+      baton->bufferOutLength = area->length;
+      area->free_fn = nullptr;
+      vips_area_unref(area);
+    }
   }
 };
 
 /*
-  pipeline(options, output, callback)
+  Convert V8 objects to non-V8 types held in a new baton struct
 */
-Napi::Value pipeline(const Napi::CallbackInfo& info) {
-  // V8 objects are converted to non-V8 types held in the baton struct
+static PipelineBaton *CreatePipelineBaton(Napi::Object options) {
   PipelineBaton *baton = new PipelineBaton;
-  Napi::Object options = info[size_t(0)].As<Napi::Object>();
 
   // Input
   baton->input = sharp::CreateInputDescriptor(options.Get("input").As<Napi::Object>());
@@ -1780,6 +2769,7 @@ Napi::Value pipeline(const Napi::CallbackInfo& info) {
   baton->affineOdy = sharp::AttrAsDouble(options, "affineOdy");
   baton->affineInterpolator = sharp::AttrAsStr(options, "affineInterpolator");
   baton->removeAlpha = sharp::AttrAsBool(options, "removeAlpha");
+  baton->removeAlphaIfOpaque = sharp::AttrAsBool(options, "removeAlphaIfOpaque");
   baton->ensureAlpha = sharp::AttrAsDouble(options, "ensureAlpha");
   if (options.Has("boolean")) {
     baton->boolean = sharp::CreateInputDescriptor(options.Get("boolean").As<Napi::Object>());
@@ -1822,6 +2812,10 @@ Napi::Value pipeline(const Napi::CallbackInfo& info) {
   baton->formatOut = sharp::AttrAsStr(options, "formatOut");
   baton->fileOut = sharp::AttrAsStr(options, "fileOut");
   baton->typedArrayOut = sharp::AttrAsBool(options, "typedArrayOut");
+  baton->typedArrayTransferable = sharp::AttrAsBool(options, "typedArrayTransferable");
+  if (sharp::HasAttr(options, "streamOutput")) {
+    baton->streamOut = *options.Get("streamOutput").As<Napi::External<std::shared_ptr<sharp::OutputStream>>>().Data();
+  }
   baton->keepMetadata = sharp::AttrAsUint32(options, "keepMetadata");
   baton->withMetadataOrientation = sharp::AttrAsUint32(options, "withMetadataOrientation");
   baton->withMetadataDensity = sharp::AttrAsDouble(options, "withMetadataDensity");
@@ -1839,6 +2833,9 @@ Napi::Value pipeline(const Napi::CallbackInfo& info) {
   baton->keepGainMap = sharp::AttrAsBool(options, "keepGainMap");
   baton->withGainMap = sharp::AttrAsBool(options, "withGainMap");
   baton->timeoutSeconds = sharp::AttrAsUint32(options, "timeoutSeconds");
+  baton->concurrency = sharp::AttrAsInt32(options, "scheduleConcurrency");
+  baton->timings = sharp::AttrAsBool(options, "timings");
+  baton->explain = sharp::AttrAsBool(options, "explain");
   baton->loop = sharp::AttrAsUint32(options, "loop");
   baton->delay = sharp::AttrAsInt32Vector(options, "delay");
   // Format-specific
@@ -1927,6 +2924,112 @@ Napi::Value pipeline(const Napi::CallbackInfo& info) {
   baton->tileCentre = sharp::AttrAsBool(options, "tileCentre");
   baton->tileId = sharp::AttrAsStr(options, "tileId");
   baton->tileBasename = sharp::AttrAsStr(options, "tileBasename");
+  return baton;
+}
+
+/*
+  Copy a baton, without parsing options again, to process a different input
+*/
+static PipelineBaton *CopyPipelineBaton(PipelineBaton const *base, sharp::InputDescriptor *input) {
+  PipelineBaton *baton = new PipelineBaton(*base);
+  baton->input = input;
+  baton->fanOut.clear();
+  baton->batch.clear();
+  if (base->boolean != nullptr) {
+    baton->boolean = new sharp::InputDescriptor(*base->boolean);
+  }
+  for (Composite *&composite : baton->composite) {
+    composite = new Composite(*composite);
+    composite->input = new sharp::InputDescriptor(*composite->input);
+  }
+  for (sharp::InputDescriptor *&joinChannelIn : baton->joinChannelIn) {
+    joinChannelIn = new sharp::InputDescriptor(*joinChannelIn);
+  }
+  for (sharp::InputDescriptor *&join : baton->join) {
+    join = new sharp::InputDescriptor(*join);
+  }
+  return baton;
+}
+
+/*
+  pipeline(options, output, callback)
+*/
+Napi::Value pipeline(const Napi::CallbackInfo& info) {
+  Napi::Object options = info[size_t(0)].As<Napi::Object>();
+  PipelineBaton *baton;
+  PreparedPipeline const *prepared = nullptr;
+  if (sharp::HasAttr(options, "prepared")) {
+    // Copy the options parsed by prepare, replacing only the input and output dimensions
+    prepared = options.Get("prepared").As<Napi::External<PreparedPipeline>>().Data();
+    baton = CopyPipelineBaton(prepared->baton, sharp::CreateInputDescriptor(options.Get("input").As<Napi::Object>()));
+    baton->aborted = std::make_shared<std::atomic<bool>>(false);
+    if (sharp::HasAttr(options, "width")) {
+      baton->width = sharp::AttrAsInt32(options, "width");
+    }
+    if (sharp::HasAttr(options, "height")) {
+      baton->height = sharp::AttrAsInt32(options, "height");
+    }
+  } else {
+    baton = CreatePipelineBaton(options);
+  }
+  // Options of a prepared task are those of its template followed by those of the call
+  auto const canonicalOptions = [&]() {
+    return (prepared != nullptr ? prepared->options : "") + sharp::CanonicalOptions(options);
+  };
+  // Can be aborted while running, by a signal or the destruction of a Stream
+  baton->abortable = options.Get("abortSignal").IsObject() || options.Get("streamOut").ToBoolean().Value() ||
+    baton->input->stream != nullptr;
+  // Multiple outputs from a single decode
+  if (options.Has("fanOut")) {
+    Napi::Array fanOut = options.Get("fanOut").As<Napi::Array>();
+    for (unsigned int i = 0; i < fanOut.Length(); i++) {
+      baton->fanOut.push_back(CreatePipelineBaton(fanOut.Get(i).As<Napi::Object>()));
+      baton->fanOut.back()->aborted = baton->aborted;
+      baton->fanOut.back()->abortable = baton->abortable;
+    }
+  }
+  // Multiple inputs with the same operations
+  if (options.Has("batch")) {
+    Napi::Array batch = options.Get("batch").As<Napi::Array>();
+    for (unsigned int i = 0; i < batch.Length(); i++) {
+      baton->batch.push_back(CopyPipelineBaton(baton,
+        sharp::CreateInputDescriptor(batch.Get(i).As<Napi::Object>())));
+    }
+  }
+
+  // Identify a task with Buffer output by its options, when the result cache is enabled
+  if (sharp::ResultCache::Instance().Enabled() && baton->fanOut.empty() && baton->batch.empty() &&
+    !baton->explain && baton->fileOut.empty() && !baton->streamOut) {
+    baton->resultKey = canonicalOptions();
+  }
+
+  // Identify a task with Buffer output by its options and inputs, when coalescing is enabled,
+  // excluding Stream output and those that can be aborted by a signal as they cannot share the work of another
+  std::string coalesceKey;
+  if (sharp::Scheduler::Instance().GetCoalesce() && baton->fanOut.empty() && baton->batch.empty() &&
+    !baton->explain && baton->fileOut.empty() && !baton->typedArrayOut &&
+    !options.Get("streamOut").ToBoolean().Value() && !options.Get("abortSignal").IsObject()) {
+    coalesceKey = TaskKey(baton, canonicalOptions(), false);
+    if (!coalesceKey.empty()) {
+      coalesceKey = std::to_string(reinterpret_cast<uintptr_t>(static_cast<napi_env>(info.Env()))) + "|" +
+        std::to_string(baton->timeoutSeconds) + "|" + std::to_string(baton->timings) + "|" + coalesceKey;
+    }
+  }
+  Napi::Function callback = info[size_t(1)].As<Napi::Function>();
+  if (!coalesceKey.empty() && PipelineWorker::Follow(coalesceKey, callback, baton)) {
+    sharp::counterCoalesced++;
+    // Nothing to abort, the task attached to continues for any others
+    return Napi::Function::New(info.Env(), [](const Napi::CallbackInfo&) {});
+  }
+
+  // Start the clock for timings
+  baton->timeQueued = std::chrono::steady_clock::now();
+  for (PipelineBaton *branch : baton->fanOut) {
+    branch->timeQueued = baton->timeQueued;
+  }
+  for (PipelineBaton *item : baton->batch) {
+    item->timeQueued = baton->timeQueued;
+  }
 
   // Function to notify of libvips warnings
   Napi::Function debuglog = options.Get("debuglog").As<Napi::Function>();
@@ -1935,14 +3038,37 @@ Napi::Value pipeline(const Napi::CallbackInfo& info) {
   Napi::Function queueListener = options.Get("queueListener").As<Napi::Function>();
 
   // Join queue for worker thread
-  Napi::Function callback = info[size_t(1)].As<Napi::Function>();
   PipelineWorker *worker = new PipelineWorker(callback, baton, debuglog, queueListener);
   worker->Receiver().Set("options", options);
-  worker->Queue();
+  if (!coalesceKey.empty()) {
+    worker->Lead(coalesceKey);
+  }
+  sharp::Scheduler::Instance().Queue(info.Env(), worker,
+    sharp::AttrAsStr(options, "schedulePriority") == "batch" ? sharp::Priority::BATCH : sharp::Priority::INTERACTIVE,
+    sharp::AttrAsStr(options, "scheduleLatency") == "long" ? sharp::Latency::LONG : sharp::Latency::SHORT);
 
   // Increment queued task counter
   Napi::Number queueLength = Napi::Number::New(info.Env(), static_cast<int>(++sharp::counterQueue));
   queueListener.SHARP_CALLBACK_FN_NAME(info.This(), { queueLength });
 
-  return info.Env().Undefined();
+  // Function to abort processing, a no-op once the task has completed
+  return Napi::Function::New(info.Env(), [worker, completed = worker->Completed()](const Napi::CallbackInfo&) {
+    if (!*completed) {
+      worker->Abort();
+    }
+  });
+}
+
+/*
+  prepare(options)
+*/
+Napi::Value prepare(const Napi::CallbackInfo& info) {
+  Napi::Object options = info[size_t(0)].As<Napi::Object>();
+  PreparedPipeline *prepared = new PreparedPipeline {
+    CreatePipelineBaton(options), sharp::CanonicalOptions(options), Napi::Persistent(options)
+  };
+  return Napi::External<PreparedPipeline>::New(info.Env(), prepared, [](Napi::Env, PreparedPipeline *prepared) {
+    DeleteBaton(prepared->baton);
+    delete prepared;
+  });
 }
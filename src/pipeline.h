@@ -6,6 +6,8 @@
 #ifndef SRC_PIPELINE_H_
 #define SRC_PIPELINE_H_
 
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -17,6 +19,7 @@
 #include "./common.h"
 
 Napi::Value pipeline(const Napi::CallbackInfo& info);
+Napi::Value prepare(const Napi::CallbackInfo& info);
 
 struct Composite {
   sharp::InputDescriptor *input;
@@ -39,17 +42,60 @@ struct Composite {
     premultiplied(false) {}
 };
 
+struct PipelinePlan {
+  std::string format;
+  int width;
+  int height;
+  int channels;
+  int pages;
+  bool sequential;
+  int shrinkOnLoad;
+  double scaleOnLoad;
+  int widthOnLoad;
+  int heightOnLoad;
+  double hshrink;
+  double vshrink;
+  bool premultiply;
+  std::vector<std::string> operations;
+  std::vector<std::string> randomAccess;
+
+  PipelinePlan():
+    width(0),
+    height(0),
+    channels(0),
+    pages(1),
+    sequential(false),
+    shrinkOnLoad(1),
+    scaleOnLoad(1.0),
+    widthOnLoad(0),
+    heightOnLoad(0),
+    hshrink(1.0),
+    vshrink(1.0),
+    premultiply(false) {}
+};
+
 struct PipelineBaton {
   sharp::InputDescriptor *input;
   std::vector<sharp::InputDescriptor *> join;
+  std::vector<PipelineBaton *> fanOut;
+  std::vector<PipelineBaton *> batch;
+  vips::VImage decodedIn;
+  sharp::ImageType decodedInType;
+  int decodedInShrink;
+  double decodedInScale;
   std::string formatOut;
   std::string fileOut;
   void *bufferOut;
   size_t bufferOutLength;
+  std::shared_ptr<sharp::OutputStream> streamOut;
   int pageHeightOut;
   int pagesOut;
   bool typedArrayOut;
+  bool typedArrayTransferable;
   bool hasAlphaOut;
+  bool iccSkipped;
+  bool embeddedThumbnailUsed;
+  int concurrencyOut;
   std::vector<Composite *> composite;
   std::vector<sharp::InputDescriptor *> joinChannelIn;
   int topOffsetPre;
@@ -216,6 +262,25 @@ struct PipelineBaton {
   bool withGainMap;
   bool keepGainMap;
   int timeoutSeconds;
+  std::shared_ptr<std::atomic<bool>> aborted;
+  bool abortable;
+  int concurrency;
+  // Returned early as its estimated memory did not fit the budget of the scheduler, to start again once it does
+  bool deferred;
+  size_t batchNext;
+  bool timings;
+  std::chrono::steady_clock::time_point timeQueued;
+  std::chrono::steady_clock::time_point timeStart;
+  std::chrono::steady_clock::time_point timeOpened;
+  std::chrono::steady_clock::time_point timeOutput;
+  std::chrono::steady_clock::time_point timeEnd;
+  size_t memoryStart;
+  size_t memoryPeak;
+  size_t memoryEnd;
+  uint64_t memoryMaterialised;
+  bool explain;
+  PipelinePlan plan;
+  std::string resultKey;
   std::vector<double> convKernel;
   int convKernelWidth;
   int convKernelHeight;
@@ -226,6 +291,7 @@ struct PipelineBaton {
   VipsOperationBoolean bandBoolOp;
   int extractChannel;
   bool removeAlpha;
+  bool removeAlphaIfOpaque;
   double ensureAlpha;
   VipsInterpretation colourspacePipeline;
   VipsInterpretation colourspace;
@@ -246,11 +312,18 @@ struct PipelineBaton {
 
   PipelineBaton():
     input(nullptr),
+    decodedInType(sharp::ImageType::UNKNOWN),
+    decodedInShrink(1),
+    decodedInScale(1.0),
     bufferOutLength(0),
     pageHeightOut(0),
     pagesOut(0),
     typedArrayOut(false),
+    typedArrayTransferable(true),
     hasAlphaOut(false),
+    iccSkipped(false),
+    embeddedThumbnailUsed(false),
+    concurrencyOut(0),
     topOffsetPre(-1),
     topOffsetPost(-1),
     channels(0),
@@ -396,6 +469,17 @@ struct PipelineBaton {
     withGainMap(false),
     keepGainMap(false),
     timeoutSeconds(0),
+    aborted(std::make_shared<std::atomic<bool>>(false)),
+    abortable(false),
+    concurrency(0),
+    deferred(false),
+    batchNext(0),
+    timings(false),
+    memoryStart(0),
+    memoryPeak(0),
+    memoryEnd(0),
+    memoryMaterialised(0),
+    explain(false),
     convKernelWidth(0),
     convKernelHeight(0),
     convKernelScale(0.0),
@@ -405,6 +489,7 @@ struct PipelineBaton {
     bandBoolOp(VIPS_OPERATION_BOOLEAN_LAST),
     extractChannel(-1),
     removeAlpha(false),
+    removeAlphaIfOpaque(false),
     ensureAlpha(-1.0),
     colourspacePipeline(VIPS_INTERPRETATION_LAST),
     colourspace(VIPS_INTERPRETATION_LAST),
@@ -419,4 +504,14 @@ struct PipelineBaton {
     tileDepth(VIPS_FOREIGN_DZ_DEPTH_LAST) {}
 };
 
+/*
+  Operations and output options parsed once, copied by each task that uses them with its own input.
+*/
+struct PreparedPipeline {
+  PipelineBaton *baton;
+  std::string options;
+  // The options passed to prepare, keeping alive the Buffers the baton and its copies point into
+  Napi::ObjectReference source;
+};
+
 #endif  // SRC_PIPELINE_H_
@@ -0,0 +1,359 @@
+/*!
+  Copyright 2013 Lovell Fuller and others.
+  SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+#ifndef _WIN32
+#include <climits>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#include <napi.h>
+
+#include "./scheduler.h"
+
+namespace sharp {
+
+  /*
+    Passes tasks back to the JS thread of the environment that queued them, keeping
+    its event loop alive only while it has tasks pending.
+  */
+  class Completion {
+   public:
+    explicit Completion(Napi::Env env) :
+      tsfn(Napi::ThreadSafeFunction::New(env, Napi::Function::New(env, [](Napi::CallbackInfo const&) {}),
+        "sharp-scheduler", 0, 1)),
+      pending(0) {
+      tsfn.Unref(env);
+    }
+
+    // Called from the JS thread
+    void Add(Napi::Env env) {
+      if (pending++ == 0) {
+        tsfn.Ref(env);
+      }
+    }
+
+    // Called from the JS thread
+    void Done(Napi::Env env) {
+      if (--pending == 0) {
+        tsfn.Unref(env);
+      }
+    }
+
+    template <typename Task>
+    napi_status Complete(Task *task) {
+      return tsfn.BlockingCall(task, [](Napi::Env env, Napi::Function, Task *task) {
+        if (env != nullptr) {
+          task->worker->OnWorkComplete(env, napi_ok);
+          task->completion->Done(env);
+        }
+        delete task;
+      });
+    }
+
+   private:
+    Napi::ThreadSafeFunction tsfn;
+    int pending;
+  };
+
+  /*
+    Completion for the given environment, created on first use
+  */
+  static std::shared_ptr<Completion> GetCompletion(Napi::Env env) {
+    std::shared_ptr<Completion> *completion = env.GetInstanceData<std::shared_ptr<Completion>>();
+    if (completion == nullptr) {
+      completion = new std::shared_ptr<Completion>(std::make_shared<Completion>(env));
+      env.SetInstanceData(completion);
+    }
+    return *completion;
+  }
+
+  Scheduler::Scheduler() :
+    workers(4),
+    threads(0),
+    runningLong(0),
+    memory(0),
+    memoryReserved(0),
+    coalesce(false) {
+    // Match the default size of the libuv thread pool, including any override
+    char const *size = std::getenv("UV_THREADPOOL_SIZE");
+    if (size != nullptr) {
+      workers = std::clamp(std::atoi(size), 1, 1024);
+    }
+  }
+
+  Scheduler& Scheduler::Instance() {
+    // Never destroyed, as detached threads may still be waiting for tasks at exit
+    static Scheduler *scheduler = new Scheduler;
+    return *scheduler;
+  }
+
+  void Scheduler::Queue(Napi::Env env, Napi::AsyncWorker *worker, Priority const priority, Latency const latency) {
+#ifdef __EMSCRIPTEN__
+    worker->Queue();
+    return;
+#endif
+    std::shared_ptr<Completion> completion = GetCompletion(env);
+    completion->Add(env);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      lanes[static_cast<int>(priority)].push_back(new Task{ worker, priority, latency, completion, 0, 0 });
+      while (threads < workers) {
+        threads++;
+        StartThread();
+      }
+    }
+    available.notify_one();
+  }
+
+  bool Scheduler::Cancel(Napi::AsyncWorker *worker) {
+#ifdef __EMSCRIPTEN__
+    return false;
+#endif
+    Task *task = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (std::deque<Task *> &lane : lanes) {
+        auto it = std::find_if(lane.begin(), lane.end(), [worker](Task *t) { return t->worker == worker; });
+        if (it != lane.end()) {
+          task = *it;
+          lane.erase(it);
+          break;
+        }
+      }
+    }
+    if (task == nullptr) {
+      return false;
+    }
+    if (task->completion->Complete(task) != napi_ok) {
+      delete task;
+    }
+    return true;
+  }
+
+  void Scheduler::SetWorkers(int const workers) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      this->workers = workers;
+      while (threads > 0 && threads < workers) {
+        threads++;
+        StartThread();
+      }
+    }
+    available.notify_all();
+  }
+
+  int Scheduler::GetWorkers() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return workers;
+  }
+
+  int Scheduler::Queued(Priority const priority) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::deque<Task *> const &lane = lanes[static_cast<int>(priority)];
+    return static_cast<int>(std::count_if(lane.begin(), lane.end(), [](Task *task) { return task->memory == 0; }));
+  }
+
+  void Scheduler::SetMemory(size_t const memory) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      this->memory = memory;
+    }
+    available.notify_all();
+  }
+
+  size_t Scheduler::GetMemory() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return memory;
+  }
+
+  void Scheduler::SetCoalesce(bool const coalesce) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->coalesce = coalesce;
+  }
+
+  bool Scheduler::GetCoalesce() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return coalesce;
+  }
+
+  int Scheduler::WaitingForMemory() {
+    std::lock_guard<std::mutex> lock(mutex);
+    int waiting = 0;
+    for (std::deque<Task *> const &lane : lanes) {
+      waiting += static_cast<int>(std::count_if(lane.begin(), lane.end(), [](Task *task) { return task->memory > 0; }));
+    }
+    return waiting;
+  }
+
+  thread_local Scheduler::Task *Scheduler::current = nullptr;
+
+  bool Scheduler::Admit(size_t const bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Task *task = current;
+    if (task == nullptr || bytes <= task->reserved) {
+      // Not run by the scheduler, or already reserved before starting again
+      return true;
+    }
+    memoryReserved -= task->reserved;
+    task->reserved = 0;
+    if (!Fits(bytes)) {
+      task->memory = bytes;
+      return false;
+    }
+    memoryReserved += bytes;
+    task->reserved = bytes;
+    return true;
+  }
+
+  /*
+    Whether an estimate fits within the memory budget, with the lock held
+  */
+  bool Scheduler::Fits(size_t const bytes) const {
+    return memory == 0 || memoryReserved == 0 || memoryReserved + bytes <= memory;
+  }
+
+  /*
+    Take the next task that may start, in order of priority, with the lock held.
+    Tasks waiting for memory start once their estimate fits, reserving it, without holding a thread meanwhile.
+  */
+  Scheduler::Task *Scheduler::Next() {
+    bool const canStartLong = runningLong < std::max(1, workers - 1);
+    for (std::deque<Task *> &lane : lanes) {
+      for (auto it = lane.begin(); it != lane.end(); it++) {
+        Task *task = *it;
+        if ((task->latency == Latency::SHORT || canStartLong) && (task->memory == 0 || Fits(task->memory))) {
+          lane.erase(it);
+          if (task->memory > 0) {
+            memoryReserved += task->memory;
+            task->reserved = task->memory;
+            task->memory = 0;
+          }
+          return task;
+        }
+      }
+    }
+    return nullptr;
+  }
+
+#ifndef _WIN32
+  /*
+    Stack size of threads in the libuv pool: the soft limit of the main thread, rounded to the page size
+  */
+  static size_t ThreadStackSize() {
+    size_t size = 8 * 1024 * 1024;
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_STACK, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+      size = static_cast<size_t>(limit.rlim_cur);
+      size -= size % static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+    return std::max(size, static_cast<size_t>(PTHREAD_STACK_MIN));
+  }
+#endif
+
+  /*
+    Start a detached thread to run tasks, with the stack size of threads in the libuv pool,
+    as the default of some C libraries, e.g. 128KB with musl, is too small for libvips.
+  */
+  void Scheduler::StartThread() {
+#ifdef _WIN32
+    std::thread(&Scheduler::Run, this).detach();
+#else
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, ThreadStackSize());
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    int const err = pthread_create(&thread, &attr, [](void *scheduler) -> void * {
+      static_cast<Scheduler *>(scheduler)->Run();
+      return nullptr;
+    }, this);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+      throw std::system_error(err, std::generic_category(), "Unable to create worker thread");
+    }
+#endif
+  }
+
+  void Scheduler::Run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      Task *task = nullptr;
+      available.wait(lock, [this, &task] { return threads > workers || (task = Next()) != nullptr; });
+      if (task == nullptr) {
+        threads--;
+        return;
+      }
+      bool const isLong = task->latency == Latency::LONG;
+      if (isLong) {
+        runningLong++;
+      }
+      lock.unlock();
+
+      current = task;
+      task->worker->OnExecute(task->worker->Env());
+      current = nullptr;
+
+      lock.lock();
+      if (isLong) {
+        runningLong--;
+      }
+      memoryReserved -= task->reserved;
+      task->reserved = 0;
+      // A queued long task, or one waiting for memory, may now be able to start
+      available.notify_all();
+      if (task->memory > 0) {
+        // Returned early as its estimate did not fit, so queue it again, ahead of tasks yet to start
+        lanes[static_cast<int>(task->priority)].push_front(task);
+        continue;
+      }
+      lock.unlock();
+      if (task->completion->Complete(task) != napi_ok) {
+        // The environment is being torn down, so the worker can no longer be deleted
+        delete task;
+      }
+      lock.lock();
+    }
+  }
+
+}  // namespace sharp
+
+/*
+  Get and set the number of scheduler threads, memory budget and coalescing, and get the number of queued tasks
+*/
+Napi::Value scheduler(const Napi::CallbackInfo& info) {
+  sharp::Scheduler &scheduler = sharp::Scheduler::Instance();
+  // Set number of threads
+  if (info[size_t(0)].IsNumber()) {
+    scheduler.SetWorkers(info[size_t(0)].As<Napi::Number>().Int32Value());
+  }
+  // Set memory budget, in MB
+  if (info[size_t(1)].IsNumber()) {
+    scheduler.SetMemory(static_cast<size_t>(info[size_t(1)].As<Napi::Number>().Uint32Value()) * 1048576);
+  }
+  // Share the result of identical tasks
+  if (info[size_t(2)].IsBoolean()) {
+    scheduler.SetCoalesce(info[size_t(2)].As<Napi::Boolean>().Value());
+  }
+  // Get state
+  Napi::Object queue = Napi::Object::New(info.Env());
+  queue.Set("interactive", scheduler.Queued(sharp::Priority::INTERACTIVE));
+  queue.Set("batch", scheduler.Queued(sharp::Priority::BATCH));
+  queue.Set("memory", scheduler.WaitingForMemory());
+  Napi::Object state = Napi::Object::New(info.Env());
+  state.Set("workers", scheduler.GetWorkers());
+  state.Set("memory", static_cast<double>(scheduler.GetMemory() / 1048576));
+  state.Set("coalesce", scheduler.GetCoalesce());
+  state.Set("queue", queue);
+  return state;
+}
@@ -0,0 +1,99 @@
+/*!
+  Copyright 2013 Lovell Fuller and others.
+  SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef SRC_SCHEDULER_H_
+#define SRC_SCHEDULER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include <napi.h>
+
+namespace sharp {
+
+  // Lanes of queued tasks, in order of priority
+  enum class Priority {
+    INTERACTIVE,
+    BATCH
+  };
+
+  // Hint of how long a task is expected to take
+  enum class Latency {
+    SHORT,
+    LONG
+  };
+
+  class Completion;
+
+  /*
+    Runs tasks on threads owned by sharp, rather than the libuv thread pool,
+    so image processing does not compete with filesystem and DNS work.
+    Interactive tasks always start before batch tasks and, when there is more than
+    one thread, at least one is kept free of long tasks so short tasks cannot be starved.
+  */
+  class Scheduler {
+   public:
+    static Scheduler& Instance();
+
+    // Queue a task from the JS thread, which is also where it completes
+    void Queue(Napi::Env env, Napi::AsyncWorker *worker, Priority const priority, Latency const latency);
+    // Remove a task that has yet to start, completing it on the JS thread without executing
+    bool Cancel(Napi::AsyncWorker *worker);
+    // Number of threads, any above a reduced number will exit once idle
+    void SetWorkers(int const workers);
+    int GetWorkers();
+    // Number of tasks waiting for a thread
+    int Queued(Priority const priority);
+    // Memory budget, in bytes, shared by all running tasks, zero for no limit
+    void SetMemory(size_t const memory);
+    size_t GetMemory();
+    // Whether a task identical to one queued or running shares its result rather than being queued
+    void SetCoalesce(bool const coalesce);
+    bool GetCoalesce();
+    // Number of tasks waiting for their estimated memory to fit within the budget
+    int WaitingForMemory();
+    // Called by a running task to reserve its estimated memory until it completes, returning false when
+    // the estimate does not fit, in which case the task must return and is queued again until it does.
+    // Always allowed when no other task holds memory.
+    bool Admit(size_t const bytes);
+
+   private:
+    struct Task {
+      Napi::AsyncWorker *worker;
+      Priority priority;
+      Latency latency;
+      std::shared_ptr<Completion> completion;
+      // Estimate that did not fit, waiting to be reserved before the task starts again
+      size_t memory;
+      // Reserved while running
+      size_t reserved;
+    };
+
+    Scheduler();
+    void StartThread();
+    void Run();
+    Task *Next();
+    bool Fits(size_t const bytes) const;
+
+    // Task running on the current thread, if any
+    static thread_local Task *current;
+    std::mutex mutex;
+    std::condition_variable available;
+    std::deque<Task *> lanes[2];
+    int workers;
+    int threads;
+    int runningLong;
+    size_t memory;
+    size_t memoryReserved;
+    bool coalesce;
+  };
+
+}  // namespace sharp
+
+Napi::Value scheduler(const Napi::CallbackInfo& info);
+
+#endif  // SRC_SCHEDULER_H_
@@ -11,7 +11,9 @@
 #include "./common.h"
 #include "./metadata.h"
 #include "./pipeline.h"
+#include "./scheduler.h"
 #include "./stats.h"
+#include "./stream.h"
 #include "./utilities.h"
 
 Napi::Object init(Napi::Env env, Napi::Object exports) {
@@ -26,8 +28,11 @@ Napi::Object init(Napi::Env env, Napi::Object exports) {
   // Methods available to JavaScript
   exports.Set("metadata", Napi::Function::New(env, metadata));
   exports.Set("pipeline", Napi::Function::New(env, pipeline));
+  exports.Set("prepare", Napi::Function::New(env, prepare));
   exports.Set("cache", Napi::Function::New(env, cache));
+  exports.Set("resultCache", Napi::Function::New(env, resultCache));
   exports.Set("concurrency", Napi::Function::New(env, concurrency));
+  exports.Set("scheduler", Napi::Function::New(env, scheduler));
   exports.Set("counters", Napi::Function::New(env, counters));
   exports.Set("simd", Napi::Function::New(env, simd));
   exports.Set("libvipsVersion", Napi::Function::New(env, libvipsVersion));
@@ -37,6 +42,12 @@ Napi::Object init(Napi::Env env, Napi::Object exports) {
   exports.Set("_isUsingJemalloc", Napi::Function::New(env, _isUsingJemalloc));
   exports.Set("_isUsingX64V2", Napi::Function::New(env, _isUsingX64V2));
   exports.Set("stats", Napi::Function::New(env, stats));
+  exports.Set("streamInputCreate", Napi::Function::New(env, streamInputCreate));
+  exports.Set("streamInputWrite", Napi::Function::New(env, streamInputWrite));
+  exports.Set("streamInputEnd", Napi::Function::New(env, streamInputEnd));
+  exports.Set("streamOutputCreate", Napi::Function::New(env, streamOutputCreate));
+  exports.Set("streamOutputResume", Napi::Function::New(env, streamOutputResume));
+  exports.Set("streamOutputDestroy", Napi::Function::New(env, streamOutputDestroy));
   return exports;
 }
 
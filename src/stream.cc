@@ -0,0 +1,336 @@
+/*!
+  Copyright 2013 Lovell Fuller and others.
+  SPDX-License-Identifier: Apache-2.0
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include <napi.h>
+#include <vips/vips8>
+
+#include "./stream.h"
+
+namespace sharp {
+
+  /*
+    Called by libvips, from the thread that is decoding, when it needs more data
+  */
+  static gint64 InputStreamReadCallback(VipsSourceCustom *source, void *buffer, gint64 length, InputStream *stream) {
+    return stream->Read(buffer, length);
+  }
+
+  InputStream::InputStream(Napi::Env env, size_t const highWaterMark, Napi::Function drain) :
+    drain(Napi::ThreadSafeFunction::New(env, drain, "sharp-stream-input", 0, 1)),
+    offset(0),
+    queued(0),
+    highWaterMark(highWaterMark),
+    waiting(false),
+    ended(false),
+    destroyed(false),
+    released(false),
+    source(vips_source_custom_new()) {
+    // Pending work keeps the event loop alive, this need not
+    this->drain.Unref(env);
+    g_signal_connect(source, "read", G_CALLBACK(InputStreamReadCallback), this);
+  }
+
+  InputStream::~InputStream() {
+    // The source can outlive this stream when referenced elsewhere, so ensure it can no longer call back
+    g_signal_handlers_disconnect_by_data(source, this);
+    g_object_unref(source);
+    Release();
+  }
+
+  bool InputStream::Write(char const *data, size_t const length) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (ended) {
+        return true;
+      }
+      chunks.emplace_back(data, length);
+      queued += length;
+      waiting = queued > highWaterMark;
+    }
+    available.notify_one();
+    return !waiting;
+  }
+
+  void InputStream::End(bool const isDestroyed) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      ended = true;
+      if (isDestroyed) {
+        destroyed = true;
+        chunks.clear();
+        offset = 0;
+        queued = 0;
+        Drain();
+      }
+      // No further writes to wait for
+      Release();
+    }
+    available.notify_all();
+  }
+
+  void InputStream::Close() {
+    std::unique_lock<std::mutex> lock(mutex);
+    ended = true;
+    chunks.clear();
+    offset = 0;
+    queued = 0;
+    Drain();
+    Release();
+  }
+
+  /*
+    Queue a call to the JS drain function, when a write is waiting for the data queued
+    to fall to the high-water mark, called with the mutex held
+  */
+  void InputStream::Drain() {
+    if (waiting && queued <= highWaterMark && !released) {
+      waiting = false;
+      drain.NonBlockingCall();
+    }
+  }
+
+  /*
+    Release the JS drain function, and with it the Stream it references, once no longer required
+  */
+  void InputStream::Release() {
+    if (!released) {
+      drain.Release();
+      released = true;
+    }
+  }
+
+  gint64 InputStream::Read(void *buffer, gint64 const length) {
+    std::unique_lock<std::mutex> lock(mutex);
+    available.wait(lock, [this] { return ended || !chunks.empty(); });
+    if (destroyed) {
+      vips_error("sharp", "Input stream was destroyed");
+      return -1;
+    }
+    if (chunks.empty()) {
+      // End of stream
+      return 0;
+    }
+    std::string const &chunk = chunks.front();
+    size_t const bytes = std::min(static_cast<size_t>(length), chunk.size() - offset);
+    memcpy(buffer, chunk.data() + offset, bytes);
+    offset += bytes;
+    queued -= bytes;
+    if (offset == chunk.size()) {
+      // Release memory as soon as each chunk has been consumed
+      chunks.pop_front();
+      offset = 0;
+    }
+    Drain();
+    return static_cast<gint64>(bytes);
+  }
+
+  vips::VSource InputStream::Source() {
+    return vips::VSource(VIPS_SOURCE(source), vips::NOSTEAL);
+  }
+
+  // Size of each chunk passed to JS, encoders write much smaller amounts at a time
+  static size_t const outputChunkSize = 65536;
+
+  /*
+    Called by libvips, from the thread that is encoding, with more data
+  */
+  static gint64 OutputStreamWriteCallback(VipsTargetCustom *target, void const *data, gint64 length,
+    OutputStream *stream) {
+    return stream->Write(data, length);
+  }
+
+  OutputStream::OutputStream(Napi::Env env, Napi::Function push) :
+    push(Napi::ThreadSafeFunction::New(env, push, "sharp-stream-output", 0, 1)),
+    pending(nullptr),
+    pendingLength(0),
+    written(0),
+    inflight(0),
+    paused(false),
+    destroyed(false),
+    released(false),
+    target(vips_target_custom_new()) {
+    // Pending work keeps the event loop alive, this need not
+    this->push.Unref(env);
+    g_signal_connect(target, "write", G_CALLBACK(OutputStreamWriteCallback), this);
+  }
+
+  OutputStream::~OutputStream() {
+    g_signal_handlers_disconnect_by_data(target, this);
+    g_object_unref(target);
+    g_free(pending);
+    if (!released) {
+      push.Release();
+    }
+  }
+
+  gint64 OutputStream::Write(void const *data, gint64 const length) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      writable.wait(lock, [this] { return !paused || destroyed; });
+      if (destroyed) {
+        vips_error("sharp", "Output stream was destroyed");
+        return -1;
+      }
+    }
+    char const *bytes = static_cast<char const*>(data);
+    size_t remaining = static_cast<size_t>(length);
+    while (remaining > 0) {
+      if (pending == nullptr) {
+        pending = static_cast<char*>(g_malloc(outputChunkSize));
+        pendingLength = 0;
+      }
+      size_t const copied = std::min(remaining, outputChunkSize - pendingLength);
+      memcpy(pending + pendingLength, bytes, copied);
+      pendingLength += copied;
+      bytes += copied;
+      remaining -= copied;
+      if (pendingLength == outputChunkSize) {
+        Flush();
+      }
+    }
+    written += static_cast<size_t>(length);
+    return length;
+  }
+
+  void OutputStream::Flush() {
+    if (pending == nullptr || pendingLength == 0) {
+      return;
+    }
+    auto chunk = new std::pair<char*, size_t>(pending, pendingLength);
+    pending = nullptr;
+    pendingLength = 0;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      inflight++;
+    }
+    napi_status const status = push.BlockingCall(chunk,
+      [this](Napi::Env env, Napi::Function push, std::pair<char*, size_t> *chunk) {
+        bool more = true;
+        if (env != nullptr) {
+          // Ownership of the memory passes to JS
+          Napi::Buffer<char> data = Napi::Buffer<char>::NewOrCopy(env, chunk->first, chunk->second,
+            [](Napi::Env, char *data) { g_free(data); });
+          more = push.Call({ data }).ToBoolean().Value();
+        } else {
+          g_free(chunk->first);
+        }
+        delete chunk;
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          inflight--;
+          if (!more) {
+            paused = true;
+          }
+        }
+        writable.notify_all();
+      });
+    if (status != napi_ok) {
+      g_free(chunk->first);
+      delete chunk;
+      std::lock_guard<std::mutex> lock(mutex);
+      inflight--;
+    }
+  }
+
+  void OutputStream::Finish(bool const flush) {
+    if (flush) {
+      Flush();
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    writable.wait(lock, [this] { return inflight == 0; });
+    if (!released) {
+      push.Release();
+      released = true;
+    }
+  }
+
+  size_t OutputStream::Length() const {
+    return written;
+  }
+
+  void OutputStream::Resume() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      paused = false;
+    }
+    writable.notify_all();
+  }
+
+  void OutputStream::Destroy() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      destroyed = true;
+    }
+    writable.notify_all();
+  }
+
+  vips::VTarget OutputStream::Target() {
+    return vips::VTarget(VIPS_TARGET(target), vips::NOSTEAL);
+  }
+
+}  // namespace sharp
+
+typedef std::shared_ptr<sharp::InputStream> InputStreamRef;
+
+/*
+  Create a new native stream to receive compressed input data,
+  calling the given JS function when the data queued falls to the given high-water mark
+*/
+Napi::Value streamInputCreate(const Napi::CallbackInfo& info) {
+  size_t const highWaterMark = info[size_t(0)].As<Napi::Number>().Uint32Value();
+  return Napi::External<InputStreamRef>::New(info.Env(),
+    new InputStreamRef(std::make_shared<sharp::InputStream>(info.Env(), highWaterMark,
+      info[size_t(1)].As<Napi::Function>())),
+    [](Napi::Env, InputStreamRef *stream) { delete stream; });
+}
+
+/*
+  Append a Buffer chunk to a native stream, returning false when further writes should wait for drain
+*/
+Napi::Value streamInputWrite(const Napi::CallbackInfo& info) {
+  InputStreamRef stream = *info[size_t(0)].As<Napi::External<InputStreamRef>>().Data();
+  Napi::Buffer<char> chunk = info[size_t(1)].As<Napi::Buffer<char>>();
+  return Napi::Boolean::New(info.Env(), stream->Write(chunk.Data(), chunk.Length()));
+}
+
+/*
+  Signal the end of a native stream, either finished or destroyed
+*/
+void streamInputEnd(const Napi::CallbackInfo& info) {
+  InputStreamRef stream = *info[size_t(0)].As<Napi::External<InputStreamRef>>().Data();
+  stream->End(info[size_t(1)].As<Napi::Boolean>().Value());
+}
+
+typedef std::shared_ptr<sharp::OutputStream> OutputStreamRef;
+
+/*
+  Create a new native stream to pass encoded output data to the given JS function
+*/
+Napi::Value streamOutputCreate(const Napi::CallbackInfo& info) {
+  return Napi::External<OutputStreamRef>::New(info.Env(),
+    new OutputStreamRef(std::make_shared<sharp::OutputStream>(info.Env(), info[size_t(0)].As<Napi::Function>())),
+    [](Napi::Env, OutputStreamRef *stream) { delete stream; });
+}
+
+/*
+  Resume writing to a native stream, after JS returned false to signal backpressure
+*/
+void streamOutputResume(const Napi::CallbackInfo& info) {
+  (*info[size_t(0)].As<Napi::External<OutputStreamRef>>().Data())->Resume();
+}
+
+/*
+  Abort writing to a native stream
+*/
+void streamOutputDestroy(const Napi::CallbackInfo& info) {
+  (*info[size_t(0)].As<Napi::External<OutputStreamRef>>().Data())->Destroy();
+}
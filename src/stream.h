@@ -0,0 +1,109 @@
+/*!
+  Copyright 2013 Lovell Fuller and others.
+  SPDX-License-Identifier: Apache-2.0
+*/
+
+#ifndef SRC_STREAM_H_
+#define SRC_STREAM_H_
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <napi.h>
+#include <vips/vips8>
+
+namespace sharp {
+
+  /*
+    Compressed image data received via the Writable side of a Stream,
+    exposed to libvips as a custom, non-seekable source.
+    Chunks are written from the JS thread and read, blocking until
+    more data arrives, from the thread that is decoding.
+    Once more than the high-water mark is queued, the JS drain function is
+    called when reads reduce it to that, providing backpressure.
+  */
+  class InputStream {
+   public:
+    InputStream(Napi::Env env, size_t const highWaterMark, Napi::Function drain);
+    ~InputStream();
+
+    // Append a copy of a chunk of data, returning false when drain will be called before more should be written
+    bool Write(char const *data, size_t const length);
+    // Signal that no further data will be written, aborting any pending read when destroyed
+    void End(bool const isDestroyed);
+    // Signal that no further data will be read, discarding that queued and yet to be written
+    void Close();
+    // Called by libvips to read up to length bytes
+    gint64 Read(void *buffer, gint64 const length);
+    // Custom libvips source backed by this stream
+    vips::VSource Source();
+
+   private:
+    void Drain();
+    void Release();
+
+    Napi::ThreadSafeFunction drain;
+    std::mutex mutex;
+    std::condition_variable available;
+    std::deque<std::string> chunks;
+    size_t offset;
+    size_t queued;
+    size_t const highWaterMark;
+    bool waiting;
+    bool ended;
+    bool destroyed;
+    bool released;
+    VipsSourceCustom *source;
+  };
+
+  /*
+    Encoded image data passed to the Readable side of a Stream as it is produced,
+    via a custom libvips target. Writes from the thread that is encoding block
+    while the Readable side is paused, providing backpressure.
+  */
+  class OutputStream {
+   public:
+    OutputStream(Napi::Env env, Napi::Function push);
+    ~OutputStream();
+
+    // Called by libvips with encoded data
+    gint64 Write(void const *data, gint64 const length);
+    // Pass any remaining data to JS, wait until all chunks have been delivered, then release the JS function
+    void Finish(bool const flush);
+    // Total number of bytes written
+    size_t Length() const;
+    // Flow control, called from the JS thread
+    void Resume();
+    void Destroy();
+    // Custom libvips target backed by this stream
+    vips::VTarget Target();
+
+   private:
+    void Flush();
+
+    Napi::ThreadSafeFunction push;
+    std::mutex mutex;
+    std::condition_variable writable;
+    char *pending;
+    size_t pendingLength;
+    size_t written;
+    int inflight;
+    bool paused;
+    bool destroyed;
+    bool released;
+    VipsTargetCustom *target;
+  };
+
+}  // namespace sharp
+
+Napi::Value streamInputCreate(const Napi::CallbackInfo& info);
+Napi::Value streamInputWrite(const Napi::CallbackInfo& info);
+void streamInputEnd(const Napi::CallbackInfo& info);
+Napi::Value streamOutputCreate(const Napi::CallbackInfo& info);
+void streamOutputResume(const Napi::CallbackInfo& info);
+void streamOutputDestroy(const Napi::CallbackInfo& info);
+
+#endif  // SRC_STREAM_H_
@@ -11,6 +11,7 @@
 #include <vips/vips8>
 #include <vips/vector.h>
 
+#include "./cache.h"
 #include "./common.h"
 #include "./operations.h"
 #include "./utilities.h"
@@ -33,6 +34,10 @@ Napi::Value cache(const Napi::CallbackInfo& info) {
   if (info[size_t(2)].IsNumber()) {
     vips_cache_set_max(info[size_t(2)].As<Napi::Number>().Uint32Value());
   }
+  // Set overlay memory limit
+  if (info[size_t(3)].IsNumber()) {
+    sharp::OverlayCache().SetMax(static_cast<size_t>(info[size_t(3)].As<Napi::Number>().Uint32Value()) * 1048576);
+  }
 
   // Get memory stats
   Napi::Object memory = Napi::Object::New(env);
@@ -49,10 +54,59 @@ Napi::Value cache(const Napi::CallbackInfo& info) {
   items.Set("current", vips_cache_get_size());
   items.Set("max", vips_cache_get_max());
 
+  // Get overlay stats
+  sharp::LruCache<VImage>::Stats const overlayStats = sharp::OverlayCache().GetStats();
+  Napi::Object overlays = Napi::Object::New(env);
+  overlays.Set("current", round(overlayStats.size / 1048576));
+  overlays.Set("max", round(overlayStats.maxSize / 1048576));
+  overlays.Set("items", static_cast<double>(overlayStats.items));
+  overlays.Set("hits", static_cast<double>(overlayStats.hits));
+  overlays.Set("misses", static_cast<double>(overlayStats.misses));
+
   Napi::Object cache = Napi::Object::New(env);
   cache.Set("memory", memory);
   cache.Set("files", files);
   cache.Set("items", items);
+  cache.Set("overlays", overlays);
+  return cache;
+}
+
+/*
+  Get and set limits of the result cache
+*/
+Napi::Value resultCache(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  sharp::ResultCache &results = sharp::ResultCache::Instance();
+
+  // Set memory limit
+  if (info[size_t(0)].IsNumber()) {
+    results.SetMemory(static_cast<size_t>(info[size_t(0)].As<Napi::Number>().Uint32Value()) * 1048576);
+  }
+  // Set disk limit and directory
+  if (info[size_t(1)].IsNumber()) {
+    std::string const directory = info[size_t(2)].IsString() ? info[size_t(2)].As<Napi::String>().Utf8Value() : "";
+    try {
+      results.SetDisk(directory, static_cast<size_t>(info[size_t(1)].As<Napi::Number>().Uint32Value()) * 1048576);
+    } catch (std::runtime_error const &err) {
+      throw Napi::Error::New(env, err.what());
+    }
+  }
+
+  sharp::ResultCache::Stats const stats = results.GetStats();
+  Napi::Object memory = Napi::Object::New(env);
+  memory.Set("current", round(stats.memory.size / 1048576));
+  memory.Set("max", round(stats.memory.maxSize / 1048576));
+  memory.Set("items", static_cast<double>(stats.memory.items));
+  Napi::Object disk = Napi::Object::New(env);
+  disk.Set("current", round(stats.disk.size / 1048576));
+  disk.Set("max", round(stats.disk.maxSize / 1048576));
+  disk.Set("items", static_cast<double>(stats.disk.items));
+
+  Napi::Object cache = Napi::Object::New(env);
+  cache.Set("memory", memory);
+  cache.Set("disk", disk);
+  cache.Set("hits", static_cast<double>(stats.hits));
+  cache.Set("misses", static_cast<double>(stats.misses));
   return cache;
 }
 
@@ -75,6 +129,9 @@ Napi::Value counters(const Napi::CallbackInfo& info) {
   Napi::Object counters = Napi::Object::New(info.Env());
   counters.Set("queue", static_cast<int>(sharp::counterQueue));
   counters.Set("process", static_cast<int>(sharp::counterProcess));
+  counters.Set("materialised", static_cast<double>(sharp::counterMaterialised));
+  counters.Set("memoryPeak", static_cast<double>(sharp::counterMemoryPeak));
+  counters.Set("coalesced", static_cast<double>(sharp::counterCoalesced));
   return counters;
 }
 
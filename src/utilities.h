@@ -9,6 +9,7 @@
 #include <napi.h>
 
 Napi::Value cache(const Napi::CallbackInfo& info);
+Napi::Value resultCache(const Napi::CallbackInfo& info);
 Napi::Value concurrency(const Napi::CallbackInfo& info);
 Napi::Value counters(const Napi::CallbackInfo& info);
 Napi::Value simd(const Napi::CallbackInfo& info);
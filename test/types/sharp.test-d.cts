@@ -411,6 +411,7 @@ sharp('input.jpg')
 // From https://sharp.pixelplumbing.com/api-output#examples-9
 // Extract alpha channel as raw pixel data from PNG input
 sharp('input.png').ensureAlpha().ensureAlpha(0).extractChannel(3).toColourspace('b-w').raw().toBuffer();
+sharp('input.png').removeAlpha({ ifOpaque: true }).resize(320).toBuffer();
 
 // From https://sharp.pixelplumbing.com/api-constructor#examples-4
 // Convert an animated GIF to an animated WebP
@@ -819,3 +820,66 @@ sharp().metadata().then((metadata: sharp.Metadata) => {
     const mediaType: sharp.MediaType = metadata.mediaType;
   }
 });
+
+sharp({ incremental: true });
+// @ts-expect-error
+sharp({ incremental: 'fail' });
+
+sharp(input).jpeg().incremental();
+sharp(input).jpeg().incremental(false);
+// @ts-expect-error
+sharp(input).incremental('fail');
+
+sharp().toUint8Array({ transferable: false });
+
+sharp(input).fanOut([(image) => image.resize(320).webp(), (image) => image.resize(640).jpeg()]);
+sharp(input).fanOut([(image) => image.png()]).then((results) => results[0].info.width);
+// @ts-expect-error
+sharp(input).fanOut([() => 'fail']);
+
+sharp.batch([input, input], sharp().resize(64).webp());
+sharp.batch([input], sharp().png(), { failOn: 'none' }).then((results) => results[0].error ?? results[0].info?.width);
+// @ts-expect-error
+sharp.batch([input]);
+
+sharp(input).schedule({ priority: 'batch', latency: 'long' });
+// @ts-expect-error
+sharp(input).schedule({ priority: 'fail' });
+sharp.scheduler({ workers: 2 }).queue.interactive;
+sharp.scheduler().workers;
+
+sharp(input, { signal: new AbortController().signal });
+// @ts-expect-error
+sharp(input, { signal: 'fail' });
+
+sharp.scheduler({ memory: 2048 }).queue.memory;
+
+sharp(input).schedule({ concurrency: 8 });
+sharp(input).schedule({ concurrency: 'auto' });
+
+sharp(input).timings().toBuffer({ resolveWithObject: true }).then(({ info }) => info.timings?.total);
+
+sharp(input).toBuffer({ resolveWithObject: true }).then(({ info }) => info.memory?.peak);
+sharp.counters().materialised;
+
+sharp(input).resize(320).explain().then((plan) => {
+  console.log(plan.input.format, plan.input.sequential, plan.shrinkOnLoad.shrink, plan.resize.hshrink);
+  console.log(plan.premultiply, plan.operations.join(), plan.randomAccess.join());
+});
+
+sharp.cache({ overlays: 20 }).overlays.hits;
+
+sharp.resultCache({ memory: 200, disk: 2000, directory: '/tmp/sharp' }).hits;
+sharp.resultCache().disk.items;
+
+sharp.scheduler({ coalesce: true }).coalesce;
+sharp.counters().coalesced;
+
+const thumbnail = sharp.prepare(sharp().resize(320).webp(), { failOn: 'none' });
+thumbnail(input).then(({ data, info }) => data.length + info.width);
+thumbnail(input, { width: 640 });
+// @ts-expect-error
+thumbnail(input, { width: '640' });
+
+sharp(input, { skipStandardIcc: true }).toBuffer({ resolveWithObject: true }).then(({ info }) => info.iccSkipped);
+sharp(input, { embeddedThumbnail: true }).resize(160).toBuffer({ resolveWithObject: true }).then(({ info }) => info.embeddedThumbnail);
@@ -0,0 +1,78 @@
+/*!
+  Copyright 2013 Lovell Fuller and others.
+  SPDX-License-Identifier: Apache-2.0
+*/
+
+const { suite, test } = require('node:test');
+
+const sharp = require('../../');
+const fixtures = require('../fixtures');
+
+suite('Abort', () => {
+  test('Signal already aborted', async (t) => {
+    t.plan(1);
+    await t.assert.rejects(
+      () => sharp(fixtures.inputJpg, { signal: AbortSignal.abort() })
+        .resize(32)
+        .toBuffer(),
+      /The operation was aborted/
+    );
+  });
+
+  test('Queued task is removed', async (t) => {
+    const { workers } = sharp.scheduler();
+    sharp.scheduler({ workers: 1 });
+    try {
+      const controller = new AbortController();
+      const running = sharp(fixtures.inputJpg).blur(10).toBuffer();
+      const queued = sharp(fixtures.inputJpg, { signal: controller.signal }).resize(32).toBuffer();
+      controller.abort();
+      t.plan(2);
+      await t.assert.rejects(() => queued, /The operation was aborted/);
+      t.assert.strictEqual(Buffer.isBuffer(await running), true);
+    } finally {
+      sharp.scheduler({ workers });
+    }
+  });
+
+  test('Running task is stopped', async (t) => {
+    const controller = new AbortController();
+    setTimeout(() => controller.abort(), 200);
+    t.plan(1);
+    await t.assert.rejects(
+      () => sharp(fixtures.inputJpg, { signal: controller.signal })
+        .blur(300)
+        .toBuffer(),
+      /The operation was aborted/
+    );
+  });
+
+  test('Signal is inherited by clones', async (t) => {
+    const controller = new AbortController();
+    const image = sharp(fixtures.inputJpg, { signal: controller.signal });
+    controller.abort();
+    t.plan(1);
+    await t.assert.rejects(
+      () => image.clone().resize(32).toBuffer(),
+      /The operation was aborted/
+    );
+  });
+
+  test('Task completes when signal is not aborted', async (t) => {
+    const controller = new AbortController();
+    const { info } = await sharp(fixtures.inputJpg, { signal: controller.signal })
+      .resize(32)
+      .toBuffer({ resolveWithObject: true });
+    controller.abort();
+    t.plan(1);
+    t.assert.strictEqual(info.width, 32);
+  });
+
+  test('Invalid signal', (t) => {
+    t.plan(1);
+    t.assert.throws(
+      () => sharp(fixtures.inputJpg, { signal: 'fail' }),
+      /Expected AbortSignal for signal but received fail of type string/
+    );
+  });
+});
@@ -136,6 +136,51 @@ suite('Alpha transparency', () => {
         })));
   });
 
+  test('Removes alpha only when fully opaque', async (t) => {
+    const opaque = await sharp({
+      create: { width: 8, height: 8, channels: 4, background: { r: 255, g: 0, b: 0, alpha: 1 } }
+    })
+      .png()
+      .toBuffer();
+    const [fromOpaque, fromTransparent, from16bit] = await Promise.all([
+      opaque,
+      fixtures.inputPngWithTransparency,
+      fixtures.inputPngWithTransparency16bit
+    ].map((input) => sharp(input)
+      .removeAlpha({ ifOpaque: true })
+      .resize(4)
+      .toBuffer({ resolveWithObject: true })));
+    t.plan(3);
+    t.assert.strictEqual(fromOpaque.info.channels, 3);
+    t.assert.strictEqual(fromTransparent.info.channels, 4);
+    t.assert.strictEqual(from16bit.info.channels, 4);
+  });
+
+  test('Keeps an opaque alpha channel when nothing would premultiply', async (t) => {
+    const opaque = await sharp({
+      create: { width: 8, height: 8, channels: 4, background: { r: 255, g: 0, b: 0, alpha: 1 } }
+    })
+      .png()
+      .toBuffer();
+    const { info } = await sharp(opaque)
+      .removeAlpha({ ifOpaque: true })
+      .toBuffer({ resolveWithObject: true });
+    t.plan(1);
+    t.assert.strictEqual(info.channels, 4);
+  });
+
+  test('Invalid removeAlpha options throw', (t) => {
+    t.plan(2);
+    t.assert.throws(
+      () => sharp().removeAlpha('fail'),
+      /Expected object for options but received fail of type string/
+    );
+    t.assert.throws(
+      () => sharp().removeAlpha({ ifOpaque: 1 }),
+      /Expected boolean for ifOpaque but received 1 of type number/
+    );
+  });
+
   test('Ensures alpha from fixtures without transparency, ignores those with', async (t) => {
     t.plan(6);
     await Promise.all([
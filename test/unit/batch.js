@@ -0,0 +1,80 @@
+/*!
+  Copyright 2013 Lovell Fuller and others.
+  SPDX-License-Identifier: Apache-2.0
+*/
+
+const fs = require('node:fs');
+const { suite, test } = require('node:test');
+
+const sharp = require('../../');
+const fixtures = require('../fixtures');
+
+suite('Batch', () => {
+  test('Same operations applied to multiple inputs', async (t) => {
+    const results = await sharp.batch(
+      [fixtures.inputJpg, fs.readFileSync(fixtures.inputPng), fixtures.inputWebP],
+      sharp().resize(32, 24).webp()
+    );
+    t.plan(1 + results.length * 5);
+    t.assert.strictEqual(results.length, 3);
+    for (const { data, info, error } of results) {
+      t.assert.strictEqual(error, undefined);
+      t.assert.strictEqual(Buffer.isBuffer(data), true);
+      t.assert.strictEqual(info.format, 'webp');
+      t.assert.strictEqual(info.width, 32);
+      t.assert.strictEqual(info.height, 24);
+    }
+  });
+
+  test('Input options are applied to every input', async (t) => {
+    const [result] = await sharp.batch(
+      [fixtures.inputJpgWithExif],
+      sharp().resize(40).raw(),
+      { autoOrient: true }
+    );
+    const { info } = await sharp(fixtures.inputJpgWithExif, { autoOrient: true })
+      .resize(40)
+      .raw()
+      .toBuffer({ resolveWithObject: true });
+    t.plan(2);
+    t.assert.strictEqual(result.info.width, info.width);
+    t.assert.strictEqual(result.info.height, info.height);
+  });
+
+  test('An input that fails does not affect others', async (t) => {
+    const [bad, good] = await sharp.batch(
+      [Buffer.from('fail'), fixtures.inputJpg],
+      sharp().resize(8).png()
+    );
+    t.plan(5);
+    t.assert.strictEqual(bad.error instanceof Error, true);
+    t.assert.match(bad.error.message, /Input buffer contains unsupported image format/);
+    t.assert.strictEqual(bad.data, undefined);
+    t.assert.strictEqual(good.error, undefined);
+    t.assert.strictEqual(good.info.format, 'png');
+  });
+
+  test('Invalid inputs', (t) => {
+    t.plan(3);
+    t.assert.throws(
+      () => sharp.batch([], sharp()),
+      /Expected non-empty Array of images for inputs but received  of type object/
+    );
+    t.assert.throws(
+      () => sharp.batch([[fixtures.inputJpg]], sharp()),
+      /Expected non-empty Array of images for inputs/
+    );
+    t.assert.throws(
+      () => sharp.batch([1], sharp()),
+      /Unsupported input '1' of type number/
+    );
+  });
+
+  test('Invalid template', (t) => {
+    t.plan(1);
+    t.assert.throws(
+      () => sharp.batch([fixtures.inputJpg], {}),
+      /Expected sharp instance for template but received \[object Object\] of type object/
+    );
+  });
+});
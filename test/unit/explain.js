@@ -0,0 +1,97 @@
+/*!
+  Copyright 2013 Lovell Fuller and others.
+  SPDX-License-Identifier: Apache-2.0
+*/
+
+const fs = require('node:fs');
+const { suite, test } = require('node:test');
+
+const sharp = require('../../');
+const fixtures = require('../fixtures');
+
+suite('Explain', () => {
+  test('JPEG shrink-on-load', async (t) => {
+    const plan = await sharp(fixtures.inputJpg).resize(320).explain();
+    t.plan(9);
+    t.assert.strictEqual(plan.input.format, 'jpeg');
+    t.assert.strictEqual(plan.input.width, 2725);
+    t.assert.strictEqual(plan.input.height, 2225);
+    t.assert.strictEqual(plan.input.channels, 3);
+    t.assert.strictEqual(plan.shrinkOnLoad.shrink, 4);
+    t.assert.strictEqual(plan.shrinkOnLoad.width, 682);
+    t.assert.ok(plan.resize.hshrink > 2 && plan.resize.hshrink < 2.2);
+    t.assert.deepStrictEqual(plan.operations, ['resize']);
+    t.assert.deepStrictEqual(plan.randomAccess, []);
+  });
+
+  test('No shrink-on-load when rotating before resize', async (t) => {
+    const plan = await sharp(fixtures.inputJpg).rotate(90).resize(320).explain();
+    t.plan(3);
+    t.assert.strictEqual(plan.shrinkOnLoad.shrink, 1);
+    t.assert.deepStrictEqual(plan.operations, ['rotate', 'resize']);
+    t.assert.deepStrictEqual(plan.randomAccess, ['rotate']);
+  });
+
+  test('Operations that require random access', async (t) => {
+    const plan = await sharp(fixtures.inputJpg)
+      .resize(320, 240, { position: 'attention' })
+      .normalise()
+      .flip()
+      .explain();
+    t.plan(2);
+    t.assert.deepStrictEqual(plan.operations, ['resize', 'flip', 'normalise']);
+    t.assert.deepStrictEqual(plan.randomAccess, ['flip', 'attention', 'normalise']);
+  });
+
+  test('Premultiply alpha when resizing', async (t) => {
+    const plan = await sharp(fixtures.inputPngWithTransparency).resize(32).explain();
+    t.plan(2);
+    t.assert.strictEqual(plan.input.format, 'png');
+    t.assert.strictEqual(plan.premultiply, true);
+  });
+
+  test('Alpha that may be removed as opaque is not premultiplied', async (t) => {
+    const plan = await sharp(fixtures.inputPngWithTransparency)
+      .removeAlpha({ ifOpaque: true })
+      .resize(32)
+      .explain();
+    t.plan(2);
+    t.assert.strictEqual(plan.premultiply, false);
+    t.assert.deepStrictEqual(plan.operations, ['removeAlpha', 'resize']);
+  });
+
+  test('Embedded thumbnail replaces shrink-on-load', async (t) => {
+    const [withThumbnail, withoutThumbnail] = await Promise.all([
+      sharp(fixtures.inputJpg320x240, { embeddedThumbnail: true }).resize(160).explain(),
+      sharp(fixtures.inputJpg320x240).resize(160).explain()
+    ]);
+    t.plan(3);
+    t.assert.strictEqual(withThumbnail.shrinkOnLoad.width >= 160, true);
+    t.assert.strictEqual(withThumbnail.shrinkOnLoad.width < 320, true);
+    t.assert.strictEqual(withoutThumbnail.shrinkOnLoad.width, 320);
+  });
+
+  test('Stream input', async (t) => {
+    const image = sharp().resize(320);
+    fs.createReadStream(fixtures.inputJpg).pipe(image);
+    const plan = await image.explain();
+    t.plan(1);
+    t.assert.strictEqual(plan.shrinkOnLoad.shrink, 4);
+  });
+
+  test('Output is unaffected', async (t) => {
+    const image = sharp(fixtures.inputJpg).resize(320);
+    await image.explain();
+    const { info } = await image.toBuffer({ resolveWithObject: true });
+    t.plan(1);
+    t.assert.strictEqual(info.width, 320);
+  });
+
+  test('Joined images are unsupported', async (t) => {
+    t.plan(1);
+    await t.assert.rejects(
+      () => sharp([fixtures.inputJpg, fixtures.inputJpg]).explain(),
+      /Cannot explain joined images/
+    );
+  });
+});
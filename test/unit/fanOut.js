@@ -0,0 +1,130 @@
+/*!
+  Copyright 2013 Lovell Fuller and others.
+  SPDX-License-Identifier: Apache-2.0
+*/
+
+const fs = require('node:fs');
+const { suite, test } = require('node:test');
+
+const sharp = require('../../');
+const fixtures = require('../fixtures');
+
+suite('Fan-out', () => {
+  test('Multiple sizes and formats from one decode', async (t) => {
+    const results = await sharp(fixtures.inputJpg).fanOut([
+      (image) => image.resize(320).webp(),
+      (image) => image.resize(640, 480).png(),
+      (image) => image.resize({ height: 100 })
+    ]);
+    t.plan(13);
+    t.assert.strictEqual(results.length, 3);
+    const [webp, png, jpeg] = results;
+    t.assert.strictEqual(Buffer.isBuffer(webp.data), true);
+    t.assert.strictEqual(webp.info.format, 'webp');
+    t.assert.strictEqual(webp.info.width, 320);
+    t.assert.strictEqual(webp.info.height, 261);
+    t.assert.strictEqual(webp.info.size, webp.data.length);
+    t.assert.strictEqual(png.info.format, 'png');
+    t.assert.strictEqual(png.info.width, 640);
+    t.assert.strictEqual(png.info.height, 480);
+    t.assert.strictEqual(jpeg.info.format, 'jpeg');
+    t.assert.strictEqual(jpeg.info.height, 100);
+
+    const metadata = await sharp(png.data).metadata();
+    t.assert.strictEqual(metadata.format, 'png');
+    t.assert.strictEqual(metadata.width, 640);
+  });
+
+  test('Matches the dimensions of separate pipelines', async (t) => {
+    const input = sharp(fixtures.inputJpgWithExif).autoOrient();
+    const [small, large] = await input.fanOut([
+      (image) => image.resize(32),
+      (image) => image.resize(240).rotate(90)
+    ]);
+    const separateSmall = await input.clone().resize(32).toBuffer({ resolveWithObject: true });
+    const separateLarge = await input.clone().resize(240).rotate(90).toBuffer({ resolveWithObject: true });
+    t.plan(4);
+    t.assert.strictEqual(small.info.width, separateSmall.info.width);
+    t.assert.strictEqual(small.info.height, separateSmall.info.height);
+    t.assert.strictEqual(large.info.width, separateLarge.info.width);
+    t.assert.strictEqual(large.info.height, separateLarge.info.height);
+  });
+
+  test('Attention focal point is relative to the input', async (t) => {
+    const cover = { fit: 'cover', position: sharp.strategy.attention };
+    const [result] = await sharp(fixtures.inputJpg).fanOut([
+      (image) => image.resize(80, 320, cover)
+    ]);
+    const separate = await sharp(fixtures.inputJpg).resize(80, 320, cover).toBuffer({ resolveWithObject: true });
+    t.plan(2);
+    t.assert.strictEqual(result.info.attentionX, separate.info.attentionX);
+    t.assert.strictEqual(result.info.attentionY, separate.info.attentionY);
+  });
+
+  test('Operations of the original are applied to every output', async (t) => {
+    const [a, b] = await sharp(fixtures.inputJpg)
+      .greyscale()
+      .fanOut([
+        (image) => image.resize(8).raw(),
+        (image) => image.resize(16).raw()
+      ]);
+    t.plan(2);
+    t.assert.strictEqual(a.info.channels, 1);
+    t.assert.strictEqual(b.info.channels, 1);
+  });
+
+  test('Stream-based input', async (t) => {
+    const input = sharp();
+    fs.createReadStream(fixtures.inputJpg).pipe(input);
+    const [a, b] = await input.fanOut([
+      (image) => image.resize(10),
+      (image) => image.resize(20)
+    ]);
+    t.plan(2);
+    t.assert.strictEqual(a.info.width, 10);
+    t.assert.strictEqual(b.info.width, 20);
+  });
+
+  test('Output is not modified by fan-out', async (t) => {
+    const input = sharp(fixtures.inputJpg);
+    await input.fanOut([(image) => image.resize(10)]);
+    const { info } = await input.toBuffer({ resolveWithObject: true });
+    t.plan(1);
+    t.assert.strictEqual(info.width, 2725);
+  });
+
+  test('Error in one output rejects', async (t) => {
+    t.plan(1);
+    await t.assert.rejects(
+      () => sharp(fixtures.inputJpg).fanOut([
+        (image) => image.resize(10),
+        (image) => image.extractChannel(3)
+      ]),
+      /Cannot extract channel 3 from image with channels 0-2/
+    );
+  });
+
+  test('Invalid input rejects', async (t) => {
+    t.plan(1);
+    await t.assert.rejects(
+      () => sharp(Buffer.from('fail')).fanOut([(image) => image]),
+      /Input buffer contains unsupported image format/
+    );
+  });
+
+  test('Invalid outputs', (t) => {
+    t.plan(3);
+    t.assert.throws(
+      () => sharp().fanOut(),
+      /Expected non-empty Array of functions for outputs but received undefined of type undefined/
+    );
+    t.assert.throws(
+      () => sharp().fanOut([]),
+      /Expected non-empty Array of functions for outputs but received  of type object/
+    );
+    t.assert.throws(
+      () => sharp().fanOut([() => 'fail']),
+      /Expected Array of functions returning a sharp instance for outputs/
+    );
+  });
+});
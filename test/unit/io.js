@@ -444,6 +444,161 @@ suite('Input/output', () => {
     });
   });
 
+  suite('Incremental Stream-based input', () => {
+    test('Read from Stream and write to Buffer', async (t) => {
+      t.plan(3);
+      const pipeline = sharp({ incremental: true }).resize(320, 240);
+      const output = pipeline.toBuffer({ resolveWithObject: true });
+      createReadStream(fixtures.inputJpg).pipe(pipeline);
+      const { info } = await output;
+      t.assert.strictEqual('jpeg', info.format);
+      t.assert.strictEqual(320, info.width);
+      t.assert.strictEqual(240, info.height);
+    });
+
+    test('Read from Stream and write to Stream', async (t) => {
+      t.plan(3);
+      const writable = createWriteStream(outputJpg);
+      const closed = new Promise((resolve, reject) => {
+        writable.once('close', resolve);
+        writable.once('error', reject);
+      });
+      createReadStream(fixtures.inputPng)
+        .pipe(sharp({ incremental: true }).resize(320, 240).jpeg())
+        .pipe(writable);
+      await closed;
+      const { format, width, height } = await sharp(outputJpg).metadata();
+      t.assert.strictEqual('jpeg', format);
+      t.assert.strictEqual(320, width);
+      t.assert.strictEqual(240, height);
+      await fs.rm(outputJpg);
+    });
+
+    test('Format requiring random access is buffered', async (t) => {
+      t.plan(2);
+      const pipeline = sharp({ incremental: true }).resize(32, 32);
+      const output = pipeline.toBuffer({ resolveWithObject: true });
+      createReadStream(fixtures.inputTiff).pipe(pipeline);
+      const { info } = await output;
+      t.assert.strictEqual('tiff', info.format);
+      t.assert.strictEqual(32, info.width);
+    });
+
+    test('Output requested after Writable side has finished', async (t) => {
+      t.plan(2);
+      const pipeline = sharp({ incremental: true }).resize(320, 240);
+      createReadStream(fixtures.inputJpg).pipe(pipeline);
+      await once(pipeline, 'finish');
+      const { info } = await pipeline.toBuffer({ resolveWithObject: true });
+      t.assert.strictEqual(320, info.width);
+      t.assert.strictEqual(240, info.height);
+    });
+
+    test('Writes wait while more than the high-water mark is queued', async (t) => {
+      t.plan(3);
+      const pipeline = sharp({ incremental: true }).resize(320, 240);
+      const output = pipeline.toBuffer({ resolveWithObject: true });
+      // Trailing data that is never read, so its write completes only once decoding has finished
+      const input = Buffer.concat([await fs.readFile(fixtures.inputJpg), Buffer.alloc(4 * pipeline.writableHighWaterMark)]);
+      const written = new Promise((resolve) => pipeline.end(input, resolve));
+      const { info } = await output;
+      await written;
+      t.assert.ok(input.length > pipeline.writableHighWaterMark);
+      t.assert.strictEqual(320, info.width);
+      t.assert.strictEqual(240, info.height);
+    });
+
+    test('Destroying the Stream aborts decoding', async (t) => {
+      t.plan(1);
+      const pipeline = sharp({ incremental: true }).resize(320, 240);
+      const output = pipeline.toBuffer();
+      pipeline.write((await fs.readFile(fixtures.inputJpg)).subarray(0, 1024));
+      pipeline.destroy();
+      await t.assert.rejects(output, /Input stream/);
+    });
+
+    test('Cannot clone once started', (t) => {
+      t.plan(1);
+      const pipeline = sharp({ incremental: true });
+      pipeline.toBuffer().catch(() => {});
+      t.assert.throws(() => pipeline.clone(), /Cannot call clone\(\) once incremental Stream-based input has started/);
+      pipeline.destroy();
+    });
+
+    test('Invalid incremental option throws', (t) => {
+      t.plan(1);
+      t.assert.throws(
+        () => sharp({ incremental: 'fail' }),
+        /Expected boolean for incremental but received fail of type string/
+      );
+    });
+  });
+
+  suite('Incremental Stream-based output', () => {
+    test('Read from File and write to Stream', async (t) => {
+      t.plan(4);
+      const pipeline = sharp(fixtures.inputJpg).resize(1024).jpeg().incremental();
+      let info;
+      pipeline.on('info', (i) => { info = i; });
+      const chunks = [];
+      for await (const chunk of pipeline) {
+        chunks.push(chunk);
+      }
+      const data = Buffer.concat(chunks);
+      t.assert.strictEqual(true, chunks.length > 1);
+      t.assert.strictEqual(data.length, info.size);
+      const { format, width } = await sharp(data).metadata();
+      t.assert.strictEqual('jpeg', format);
+      t.assert.strictEqual(1024, width);
+    });
+
+    test('Read from Stream and write to Stream', async (t) => {
+      t.plan(3);
+      const writable = createWriteStream(outputJpg);
+      const closed = new Promise((resolve, reject) => {
+        writable.once('close', resolve);
+        writable.once('error', reject);
+      });
+      createReadStream(fixtures.inputJpg)
+        .pipe(sharp({ incremental: true }).resize(320, 240).incremental())
+        .pipe(writable);
+      await closed;
+      const { format, width, height } = await sharp(outputJpg).metadata();
+      t.assert.strictEqual('jpeg', format);
+      t.assert.strictEqual(320, width);
+      t.assert.strictEqual(240, height);
+      await fs.rm(outputJpg);
+    });
+
+    test('Buffered format still emits data', async (t) => {
+      t.plan(2);
+      const pipeline = sharp(fixtures.inputJpg).resize(32, 32).tiff().incremental();
+      const chunks = [];
+      for await (const chunk of pipeline) {
+        chunks.push(chunk);
+      }
+      const { format, width } = await sharp(Buffer.concat(chunks)).metadata();
+      t.assert.strictEqual('tiff', format);
+      t.assert.strictEqual(32, width);
+    });
+
+    test('Destroying the Stream stops encoding', async (t) => {
+      t.plan(1);
+      const pipeline = sharp(fixtures.inputJpg).png({ compressionLevel: 0 }).incremental();
+      pipeline.once('data', () => pipeline.destroy());
+      await once(pipeline, 'close');
+      t.assert.strictEqual(true, pipeline.destroyed);
+    });
+
+    test('Invalid incremental option throws', (t) => {
+      t.plan(1);
+      t.assert.throws(
+        () => sharp().incremental('fail'),
+        /Expected boolean for incremental but received fail of type string/
+      );
+    });
+  });
+
   test('Non-Stream input generates error when provided Stream-like data', async (t) => {
     t.plan(2);
     t.assert.throws(
@@ -823,6 +978,38 @@ suite('Input/output', () => {
     });
   });
 
+  test('can skip conversion of sRGB-equivalent ICC profile', async (t) => {
+    const input = await sharp(fixtures.inputJpg).resize(32).withIccProfile('srgb').jpeg().toBuffer();
+    const skipped = await sharp(input, { skipStandardIcc: true }).raw().toBuffer({ resolveWithObject: true });
+    const converted = await sharp(input).raw().toBuffer({ resolveWithObject: true });
+    const prophoto = await sharp(fixtures.inputPngWithProPhotoProfile, { skipStandardIcc: true })
+      .resize(32)
+      .toBuffer({ resolveWithObject: true });
+    t.plan(4);
+    t.assert.strictEqual(skipped.info.iccSkipped, true);
+    t.assert.strictEqual(converted.info.iccSkipped, undefined);
+    t.assert.ok(skipped.data.every((value, i) => Math.abs(value - converted.data[i]) <= 2));
+    t.assert.strictEqual(prophoto.info.iccSkipped, false);
+  });
+
+  test('can use embedded EXIF thumbnail when large enough', async (t) => {
+    const small = await sharp(fixtures.inputJpg320x240, { embeddedThumbnail: true })
+      .resize(160)
+      .toBuffer({ resolveWithObject: true });
+    const large = await sharp(fixtures.inputJpg320x240, { embeddedThumbnail: true })
+      .resize(240)
+      .toBuffer({ resolveWithObject: true });
+    const ignored = await sharp(fixtures.inputJpg320x240)
+      .resize(160)
+      .toBuffer({ resolveWithObject: true });
+    t.plan(5);
+    t.assert.strictEqual(small.info.embeddedThumbnail, true);
+    t.assert.strictEqual(small.info.width, 160);
+    t.assert.strictEqual(small.info.height, 120);
+    t.assert.strictEqual(large.info.embeddedThumbnail, false);
+    t.assert.strictEqual(ignored.info.embeddedThumbnail, undefined);
+  });
+
   suite('Switch off safety limits for certain formats', () => {
     test('Valid', (t) => {
       t.plan(1);
@@ -1041,6 +1228,20 @@ suite('Input/output', () => {
         /Expected number between 1 and 100000 for density but received 50 of type object/
       );
     });
+    test('Invalid skipStandardIcc: string', (t) => {
+      t.plan(1);
+      t.assert.throws(
+        () => sharp({ skipStandardIcc: 'zoinks' }),
+        /Expected boolean for skipStandardIcc but received zoinks of type string/
+      );
+    });
+    test('Invalid embeddedThumbnail: string', (t) => {
+      t.plan(1);
+      t.assert.throws(
+        () => sharp({ embeddedThumbnail: 'zoinks' }),
+        /Expected boolean for embeddedThumbnail but received zoinks of type string/
+      );
+    });
     test('Invalid ignoreIcc: string', (t) => {
       t.plan(1);
       t.assert.throws(
@@ -1378,4 +1579,27 @@ suite('Input/output', () => {
     t.assert.strictEqual(metadata.width, 8);
     t.assert.strictEqual(metadata.height, 8);
   });
+
+  test('toUint8Array with transferable false resolves without copying', async (t) => {
+    const { data, info } = await sharp(fixtures.inputJpg)
+      .resize({ width: 8, height: 8 })
+      .raw()
+      .toUint8Array({ transferable: false });
+
+    t.plan(isMarkedAsUntransferable && buildPlatformArch() !== 'wasm32' ? 4 : 3);
+    t.assert.strictEqual(data instanceof Uint8Array, true);
+    if (isMarkedAsUntransferable && buildPlatformArch() !== 'wasm32') {
+      t.assert.strictEqual(isMarkedAsUntransferable(data.buffer), true);
+    }
+    t.assert.strictEqual(data.byteLength, info.size);
+    t.assert.strictEqual(info.size, 8 * 8 * 3);
+  });
+
+  test('toUint8Array invalid transferable throws', (t) => {
+    t.plan(1);
+    t.assert.throws(
+      () => sharp().toUint8Array({ transferable: 1 }),
+      /Expected boolean for transferable but received 1 of type number/
+    );
+  });
 });
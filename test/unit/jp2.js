@@ -51,6 +51,17 @@ suite('JP2 output', () => {
       t.assert.strictEqual(3, info.channels);
     });
 
+    test('JP2 shrink-on-load decodes a reduced resolution', async (t) => {
+      t.plan(3);
+      const plan = await sharp(fixtures.inputJp2).resize(32).explain();
+      const { info } = await sharp(fixtures.inputJp2)
+        .resize(32)
+        .toBuffer({ resolveWithObject: true });
+      t.assert.ok(plan.shrinkOnLoad.scale < 1);
+      t.assert.ok(plan.shrinkOnLoad.width < plan.input.width);
+      t.assert.strictEqual(info.width, 32);
+    });
+
     test('JP2 quality', async (t) => {
       t.plan(1);
       const buffer70 = await sharp(fixtures.inputJp2)
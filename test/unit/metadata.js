@@ -1097,6 +1097,19 @@ suite('Image metadata', () => {
     t.assert.strictEqual(icc.parse(metadata.icc).description, 'sP3C');
   });
 
+  test('attach equivalent ICC profile without transform', async (t) => {
+    t.plan(2);
+    const withProfile = await sharp(fixtures.inputJpg).resize(8).withIccProfile('srgb').png().toBuffer();
+    const withoutProfile = await sharp(fixtures.inputJpg).resize(8).png().toBuffer();
+    const metadata = await sharp(withProfile).metadata();
+    t.assert.ok(Buffer.isBuffer(metadata.icc));
+    const [transformed, original] = await Promise.all([
+      sharp(withProfile, { ignoreIcc: true }).raw().toBuffer(),
+      sharp(withoutProfile).raw().toBuffer()
+    ]);
+    t.assert.ok(transformed.equals(original));
+  });
+
   test('transform to ICC profile but do not attach', async (t) => {
     t.plan(1);
     const data = await sharp({ create }).png().withIccProfile('p3', { attach: false }).toBuffer();
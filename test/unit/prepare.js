@@ -0,0 +1,89 @@
+/*!
+  Copyright 2013 Lovell Fuller and others.
+  SPDX-License-Identifier: Apache-2.0
+*/
+
+const fs = require('node:fs');
+const { suite, test } = require('node:test');
+
+const sharp = require('../../');
+const fixtures = require('../fixtures');
+
+suite('Prepare', () => {
+  test('Same operations applied to each input', async (t) => {
+    const thumbnail = sharp.prepare(sharp().resize(32, 24).webp());
+    const results = await Promise.all([
+      thumbnail(fixtures.inputJpg),
+      thumbnail(fs.readFileSync(fixtures.inputPng)),
+      thumbnail(fixtures.inputWebP)
+    ]);
+    t.plan(results.length * 4);
+    for (const { data, info } of results) {
+      t.assert.strictEqual(Buffer.isBuffer(data), true);
+      t.assert.strictEqual(info.format, 'webp');
+      t.assert.strictEqual(info.width, 32);
+      t.assert.strictEqual(info.height, 24);
+    }
+  });
+
+  test('Output matches an unprepared task', async (t) => {
+    const thumbnail = sharp.prepare(sharp().resize(40).raw(), { autoOrient: true });
+    const prepared = await thumbnail(fixtures.inputJpgWithExif);
+    const { data, info } = await sharp(fixtures.inputJpgWithExif, { autoOrient: true })
+      .resize(40)
+      .raw()
+      .toBuffer({ resolveWithObject: true });
+    t.plan(3);
+    t.assert.strictEqual(prepared.info.width, info.width);
+    t.assert.strictEqual(prepared.info.height, info.height);
+    t.assert.ok(prepared.data.equals(data));
+  });
+
+  test('Output dimensions can change for each input', async (t) => {
+    const thumbnail = sharp.prepare(sharp().resize(32, 24).png());
+    const { info } = await thumbnail(fixtures.inputJpg, { width: 64, height: 48 });
+    t.plan(2);
+    t.assert.strictEqual(info.width, 64);
+    t.assert.strictEqual(info.height, 48);
+  });
+
+  test('Template changes after prepare have no effect', async (t) => {
+    const template = sharp().resize(16).png();
+    const thumbnail = sharp.prepare(template);
+    template.resize(8).jpeg();
+    const { info } = await thumbnail(fixtures.inputJpg);
+    t.plan(2);
+    t.assert.strictEqual(info.width, 16);
+    t.assert.strictEqual(info.format, 'png');
+  });
+
+  test('An input that fails rejects', async (t) => {
+    const thumbnail = sharp.prepare(sharp().resize(8));
+    t.plan(1);
+    await t.assert.rejects(
+      () => thumbnail(Buffer.from('fail')),
+      /Input buffer contains unsupported image format/
+    );
+  });
+
+  test('Invalid', (t) => {
+    const thumbnail = sharp.prepare(sharp());
+    t.plan(4);
+    t.assert.throws(
+      () => sharp.prepare({}),
+      /Expected sharp instance for template but received \[object Object\] of type object/
+    );
+    t.assert.throws(
+      () => thumbnail([fixtures.inputJpg, fixtures.inputJpg]),
+      /Expected single image for input/
+    );
+    t.assert.throws(
+      () => thumbnail(fixtures.inputJpg, { width: 0 }),
+      /Expected positive integer for width but received 0 of type number/
+    );
+    t.assert.throws(
+      () => thumbnail(1),
+      /Unsupported input '1' of type number/
+    );
+  });
+});
@@ -0,0 +1,100 @@
+/*!
+  Copyright 2013 Lovell Fuller and others.
+  SPDX-License-Identifier: Apache-2.0
+*/
+
+const fs = require('node:fs');
+const os = require('node:os');
+const path = require('node:path');
+const { afterEach, suite, test } = require('node:test');
+
+const sharp = require('../../');
+const fixtures = require('../fixtures');
+
+suite('Result cache', () => {
+  afterEach(() => {
+    sharp.resultCache({ memory: 0, disk: 0 });
+  });
+
+  test('Disabled by default', (t) => {
+    t.plan(2);
+    const { memory, disk } = sharp.resultCache();
+    t.assert.strictEqual(memory.max, 0);
+    t.assert.strictEqual(disk.max, 0);
+  });
+
+  test('Identical tasks return the cached output', async (t) => {
+    sharp.resultCache({ memory: 10 });
+    const { hits, misses } = sharp.resultCache();
+    const first = await sharp(fixtures.inputJpg).resize(32).toBuffer({ resolveWithObject: true });
+    const second = await sharp(fixtures.inputJpg).resize(32).toBuffer({ resolveWithObject: true });
+    const other = await sharp(fixtures.inputJpg).resize(48).toBuffer({ resolveWithObject: true });
+    const stats = sharp.resultCache();
+    t.plan(6);
+    t.assert.strictEqual(stats.hits - hits, 1);
+    t.assert.strictEqual(stats.misses - misses, 2);
+    t.assert.strictEqual(stats.memory.items, 2);
+    t.assert.ok(first.data.equals(second.data));
+    t.assert.strictEqual(second.info.width, 32);
+    t.assert.strictEqual(other.info.width, 48);
+  });
+
+  test('Results on disk are reused', async (t) => {
+    const directory = fs.mkdtempSync(path.join(os.tmpdir(), 'sharp-result-cache-'));
+    try {
+      sharp.resultCache({ disk: 10, directory });
+      const first = await sharp(fixtures.inputJpg).resize(32).png().toBuffer();
+      // As would a new process
+      sharp.resultCache({ disk: 0 });
+      const { disk, hits } = sharp.resultCache({ disk: 10, directory });
+      const second = await sharp(fixtures.inputJpg).resize(32).png().toBuffer();
+      t.plan(4);
+      t.assert.strictEqual(fs.readdirSync(directory).length, 1);
+      t.assert.strictEqual(disk.items, 1);
+      t.assert.strictEqual(sharp.resultCache().hits - hits, 1);
+      t.assert.ok(first.equals(second));
+    } finally {
+      fs.rmSync(directory, { recursive: true });
+    }
+  });
+
+  test('Timings of a cached result', async (t) => {
+    sharp.resultCache({ memory: 10 });
+    await sharp(fixtures.inputJpg).resize(32).timings().toBuffer();
+    const { hits } = sharp.resultCache();
+    const { info } = await sharp(fixtures.inputJpg).resize(32).timings().toBuffer({ resolveWithObject: true });
+    t.plan(8);
+    t.assert.strictEqual(sharp.resultCache().hits - hits, 1);
+    t.assert.ok(info.timings.queue >= 0);
+    t.assert.strictEqual(info.timings.open, 0);
+    t.assert.strictEqual(info.timings.pipeline, 0);
+    t.assert.strictEqual(info.timings.output, 0);
+    t.assert.strictEqual(info.timings.total, info.timings.queue);
+    t.assert.strictEqual(info.memory.delta, 0);
+    t.assert.strictEqual(info.memory.peak, 0);
+  });
+
+  test('File output is not cached', async (t) => {
+    sharp.resultCache({ memory: 10 });
+    const { misses } = sharp.resultCache();
+    await sharp(fixtures.inputJpg).resize(32).toFile(fixtures.path('output.jpg'));
+    t.plan(1);
+    t.assert.strictEqual(sharp.resultCache().misses, misses);
+  });
+
+  test('Invalid', (t) => {
+    t.plan(3);
+    t.assert.throws(
+      () => sharp.resultCache('fail'),
+      /Expected object for options but received fail of type string/
+    );
+    t.assert.throws(
+      () => sharp.resultCache({ memory: -1 }),
+      /Expected a positive integer for memory but received -1 of type number/
+    );
+    t.assert.throws(
+      () => sharp.resultCache({ disk: 10 }),
+      /Expected non-empty string for directory but received undefined of type undefined/
+    );
+  });
+});
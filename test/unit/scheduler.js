@@ -0,0 +1,183 @@
+/*!
+  Copyright 2013 Lovell Fuller and others.
+  SPDX-License-Identifier: Apache-2.0
+*/
+
+const fs = require('node:fs');
+const { suite, test } = require('node:test');
+
+const sharp = require('../../');
+const fixtures = require('../fixtures');
+
+suite('Scheduler', () => {
+  test('Get and set number of workers', (t) => {
+    t.plan(5);
+    const { workers, queue } = sharp.scheduler();
+    t.assert.ok(workers > 0);
+    t.assert.strictEqual(typeof queue.interactive, 'number');
+    t.assert.strictEqual(typeof queue.batch, 'number');
+    t.assert.strictEqual(sharp.scheduler({ workers: 2 }).workers, 2);
+    t.assert.strictEqual(sharp.scheduler({ workers }).workers, workers);
+  });
+
+  test('Interactive and batch tasks complete', async (t) => {
+    const tasks = [];
+    for (const priority of ['batch', 'interactive']) {
+      for (const latency of ['long', 'short']) {
+        tasks.push(sharp(fixtures.inputJpg)
+          .resize(32)
+          .schedule({ priority, latency })
+          .toBuffer({ resolveWithObject: true }));
+      }
+    }
+    const results = await Promise.all(tasks);
+    t.plan(results.length);
+    for (const { info } of results) {
+      t.assert.strictEqual(info.width, 32);
+    }
+  });
+
+  test('Tasks complete with a single worker', async (t) => {
+    const { workers } = sharp.scheduler();
+    sharp.scheduler({ workers: 1 });
+    try {
+      const results = await Promise.all([
+        sharp(fixtures.inputJpg).resize(8).schedule({ latency: 'long' }).toBuffer({ resolveWithObject: true }),
+        sharp(fixtures.inputJpg).resize(16).schedule({ priority: 'batch' }).toBuffer({ resolveWithObject: true })
+      ]);
+      t.plan(2);
+      t.assert.strictEqual(results[0].info.width, 8);
+      t.assert.strictEqual(results[1].info.width, 16);
+    } finally {
+      sharp.scheduler({ workers });
+    }
+  });
+
+  test('Per-task libvips concurrency', async (t) => {
+    const results = await Promise.all([
+      sharp(fixtures.inputJpg).resize(320).schedule({ concurrency: 1 }).toBuffer({ resolveWithObject: true }),
+      sharp(fixtures.inputJpg).resize(640).schedule({ concurrency: 8 }).toBuffer({ resolveWithObject: true }),
+      sharp(fixtures.inputJpg).resize(960).schedule({ concurrency: 'auto' }).toBuffer({ resolveWithObject: true })
+    ]);
+    t.plan(3);
+    t.assert.strictEqual(results[0].info.width, 320);
+    t.assert.strictEqual(results[1].info.width, 640);
+    t.assert.strictEqual(results[2].info.width, 960);
+  });
+
+  test('Per-task libvips concurrency survives shrink-on-load', async (t) => {
+    const plan = await sharp(fixtures.inputJpg).resize(32).explain();
+    const { info } = await sharp(fixtures.inputJpg)
+      .resize(32)
+      .schedule({ concurrency: 3 })
+      .toBuffer({ resolveWithObject: true });
+    t.plan(3);
+    t.assert.strictEqual(plan.shrinkOnLoad.shrink, 8);
+    t.assert.strictEqual(info.width, 32);
+    t.assert.strictEqual(info.concurrency, 3);
+  });
+
+  test('Get and set memory budget', (t) => {
+    t.plan(4);
+    const { memory, queue } = sharp.scheduler();
+    t.assert.strictEqual(memory, 0);
+    t.assert.strictEqual(queue.memory, 0);
+    t.assert.strictEqual(sharp.scheduler({ memory: 64 }).memory, 64);
+    t.assert.strictEqual(sharp.scheduler({ memory: 0 }).memory, 0);
+  });
+
+  test('Tasks larger than the memory budget complete', async (t) => {
+    sharp.scheduler({ memory: 1 });
+    try {
+      const results = await Promise.all([
+        sharp(fixtures.inputJpg).rotate(90).resize(8).toBuffer({ resolveWithObject: true }),
+        sharp(fixtures.inputPng).resize(16).toBuffer({ resolveWithObject: true }),
+        sharp(fixtures.inputJpg).fanOut([(image) => image.resize(24)])
+      ]);
+      t.plan(4);
+      t.assert.strictEqual(results[0].info.width, 8);
+      t.assert.strictEqual(results[1].info.width, 16);
+      t.assert.strictEqual(results[2][0].info.width, 24);
+      t.assert.strictEqual(sharp.scheduler().queue.memory, 0);
+    } finally {
+      sharp.scheduler({ memory: 0 });
+    }
+  });
+
+  test('Invalid workers', (t) => {
+    t.plan(3);
+    t.assert.throws(
+      () => sharp.scheduler('fail'),
+      /Expected object for options but received fail of type string/
+    );
+    t.assert.throws(
+      () => sharp.scheduler({ workers: 0 }),
+      /Expected integer between 1 and 1024 for workers but received 0 of type number/
+    );
+    t.assert.throws(
+      () => sharp.scheduler({ workers: 1.5 }),
+      /Expected integer between 1 and 1024 for workers but received 1.5 of type number/
+    );
+  });
+
+  test('Invalid memory', (t) => {
+    t.plan(2);
+    t.assert.throws(
+      () => sharp.scheduler({ memory: -1 }),
+      /Expected integer between 0 and 4194304 for memory but received -1 of type number/
+    );
+    t.assert.throws(
+      () => sharp.scheduler({ memory: 'fail' }),
+      /Expected integer between 0 and 4194304 for memory but received fail of type string/
+    );
+  });
+
+  test('Invalid coalesce', (t) => {
+    t.plan(1);
+    t.assert.throws(
+      () => sharp.scheduler({ coalesce: 'fail' }),
+      /Expected boolean for coalesce but received fail of type string/
+    );
+  });
+
+  test('Identical tasks are coalesced', async (t) => {
+    sharp.scheduler({ coalesce: true });
+    try {
+      const { coalesced } = sharp.counters();
+      const input = fs.readFileSync(fixtures.inputJpg);
+      const results = await Promise.all([
+        sharp(input).resize(32).toBuffer({ resolveWithObject: true }),
+        sharp(input).resize(32).toBuffer({ resolveWithObject: true }),
+        sharp(input).resize(48).toBuffer({ resolveWithObject: true })
+      ]);
+      t.plan(5);
+      t.assert.strictEqual(sharp.counters().coalesced - coalesced, 1);
+      t.assert.ok(results[0].data.equals(results[1].data));
+      t.assert.notStrictEqual(results[0].info, results[1].info);
+      t.assert.strictEqual(results[1].info.width, 32);
+      t.assert.strictEqual(results[2].info.width, 48);
+    } finally {
+      sharp.scheduler({ coalesce: false });
+    }
+  });
+
+  test('Invalid schedule', (t) => {
+    t.plan(4);
+    t.assert.throws(
+      () => sharp().schedule('fail'),
+      /Expected object for options but received fail of type string/
+    );
+    t.assert.throws(
+      () => sharp().schedule({ priority: 'fail' }),
+      /Expected one of: interactive, batch for priority but received fail of type string/
+    );
+    t.assert.throws(
+      () => sharp().schedule({ latency: 'fail' }),
+      /Expected one of: short, long for latency but received fail of type string/
+    );
+    t.assert.throws(
+      () => sharp().schedule({ concurrency: 0 }),
+      /Expected integer between 1 and 1024, or auto for concurrency but received 0 of type number/
+    );
+  });
+});
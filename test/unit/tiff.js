@@ -456,6 +456,23 @@ suite('TIFF', () => {
     await fs.rm(outputTiff);
   });
 
+  test('TIFF pyramid shrink-on-load decodes the smallest sufficient level', async (t) => {
+    const pyramid = await sharp(fixtures.inputJpg)
+      .tiff({ pyramid: true, tile: true })
+      .toBuffer();
+    const plan = await sharp(pyramid).resize(320).explain();
+    const { info } = await sharp(pyramid)
+      .resize(320)
+      .toBuffer({ resolveWithObject: true });
+    t.plan(5);
+    t.assert.strictEqual(plan.input.width, 2725);
+    // Levels are 2725, 1362, 681, 340 and 170 pixels wide
+    t.assert.strictEqual(plan.shrinkOnLoad.width, 340);
+    t.assert.ok(plan.shrinkOnLoad.scale < 1);
+    t.assert.strictEqual(info.width, 320);
+    t.assert.strictEqual(info.height, 261);
+  });
+
   test('TIFF pyramid true value does not throw error', (t) => {
     t.plan(1);
     t.assert.doesNotThrow(() => {
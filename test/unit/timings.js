@@ -0,0 +1,64 @@
+/*!
+  Copyright 2013 Lovell Fuller and others.
+  SPDX-License-Identifier: Apache-2.0
+*/
+
+const { suite, test } = require('node:test');
+
+const sharp = require('../../');
+const fixtures = require('../fixtures');
+
+const stages = ['queue', 'open', 'pipeline', 'output', 'total'];
+
+suite('Timings', () => {
+  test('Not reported by default', async (t) => {
+    t.plan(1);
+    const { info } = await sharp(fixtures.inputJpg)
+      .resize(32)
+      .toBuffer({ resolveWithObject: true });
+    t.assert.strictEqual(info.timings, undefined);
+  });
+
+  test('Reported for each stage', async (t) => {
+    const { info } = await sharp(fixtures.inputJpg)
+      .resize(32)
+      .timings()
+      .toBuffer({ resolveWithObject: true });
+    t.plan(stages.length + 1);
+    for (const stage of stages) {
+      t.assert.ok(info.timings[stage] >= 0, stage);
+    }
+    const sum = info.timings.queue + info.timings.open + info.timings.pipeline + info.timings.output;
+    t.assert.ok(Math.abs(info.timings.total - sum) < 1);
+  });
+
+  test('Reported for each output of fan-out', async (t) => {
+    const results = await sharp(fixtures.inputJpg)
+      .timings()
+      .fanOut([
+        (image) => image.resize(8),
+        (image) => image.resize(16)
+      ]);
+    t.plan(2);
+    for (const { info } of results) {
+      t.assert.ok(info.timings.total > 0);
+    }
+  });
+
+  test('Can be disabled', async (t) => {
+    t.plan(1);
+    const { info } = await sharp(fixtures.inputJpg)
+      .timings()
+      .timings(false)
+      .toBuffer({ resolveWithObject: true });
+    t.assert.strictEqual(info.timings, undefined);
+  });
+
+  test('Invalid', (t) => {
+    t.plan(1);
+    t.assert.throws(
+      () => sharp().timings('fail'),
+      /Expected boolean for timings but received fail of type string/
+    );
+  });
+});
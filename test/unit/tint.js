@@ -106,6 +106,16 @@ suite('Tint', () => {
     );
   });
 
+  test('repeated tint of the same colour produces the same output', async (t) => {
+    const tint = () => sharp(fixtures.inputJpg).resize(32).tint('#704214').raw().toBuffer();
+    const first = await tint();
+    const second = await tint();
+    const other = await sharp(fixtures.inputJpg).resize(32).tint('#0000FF').raw().toBuffer();
+    t.plan(2);
+    t.assert.ok(first.equals(second));
+    t.assert.ok(!first.equals(other));
+  });
+
   test('non-numeric colour component fails, identifying the channel', (t) => {
     t.plan(3);
     t.assert.throws(
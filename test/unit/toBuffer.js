@@ -20,6 +20,17 @@ suite('toBuffer', () => {
     t.assert.strictEqual(Buffer.isBuffer(data), true);
   });
 
+  test('info contains memory usage', async (t) => {
+    const { info } = await sharp(fixtures.inputJpg)
+      .rotate(90)
+      .resize(32)
+      .toBuffer({ resolveWithObject: true });
+    t.plan(3);
+    t.assert.strictEqual(typeof info.memory.delta, 'number');
+    t.assert.ok(info.memory.peak >= 0);
+    t.assert.ok(info.memory.materialised > 0);
+  });
+
   test('correctly process animated webp with height > 16383', async (t) => {
     t.plan(1);
     const data = await sharp(fixtures.inputWebPAnimatedBigHeight, { animated: true })
@@ -7,6 +7,7 @@ const { suite, test } = require('node:test');
 const semver = require('semver');
 
 const sharp = require('../../');
+const fixtures = require('../fixtures');
 const { buildPlatformArch } = require('../../dist/libvips.cjs');
 
 // vips_cache_set_max_mem takes a size_t, so the 4096MB byte count overflows on 32-bit
@@ -77,11 +78,51 @@ suite('Utilities', () => {
       t.assert.strictEqual(cache.files.max, 20);
       t.assert.strictEqual(cache.items.max, 100);
     });
+    test('File input is held open within the files limit', async (t) => {
+      sharp.cache({ files: 1 });
+      try {
+        const render = (input) => sharp(input).resize(32).toBuffer();
+        const first = await render(fixtures.inputJpg);
+        await render(fixtures.inputPng);
+        await render(fixtures.inputWebP);
+        const second = await render(fixtures.inputJpg);
+        t.plan(2);
+        t.assert.ok(sharp.cache().files.current <= 1);
+        t.assert.ok(first.equals(second));
+      } finally {
+        sharp.cache(true);
+      }
+    });
+    test('Overlays are decoded once', async (t) => {
+      const watermark = await sharp(fixtures.inputPngWithTransparency).resize(64).png().toBuffer();
+      const render = () => sharp(fixtures.inputJpg)
+        .resize(320)
+        .composite([{ input: watermark, gravity: 'southeast' }])
+        .raw()
+        .toBuffer();
+      const uncached = await render();
+      sharp.cache({ overlays: 20 });
+      try {
+        const { hits, misses } = sharp.cache().overlays;
+        const first = await render();
+        const second = await render();
+        const { overlays } = sharp.cache();
+        t.plan(5);
+        t.assert.strictEqual(overlays.max, 20);
+        t.assert.strictEqual(overlays.items, 1);
+        t.assert.strictEqual(overlays.misses - misses, 1);
+        t.assert.strictEqual(overlays.hits - hits, 1);
+        t.assert.ok(uncached.equals(first) && first.equals(second));
+      } finally {
+        sharp.cache({ overlays: 0 });
+      }
+    });
     test('Rejects negative values', (t) => {
-      t.plan(3);
+      t.plan(4);
       t.assert.throws(() => sharp.cache({ memory: -1 }), /Expected a positive integer for memory but received -1 of type number/);
       t.assert.throws(() => sharp.cache({ files: -1 }), /Expected a positive integer for files but received -1 of type number/);
       t.assert.throws(() => sharp.cache({ items: 1.5 }), /Expected a positive integer for items but received 1.5 of type number/);
+      t.assert.throws(() => sharp.cache({ overlays: -1 }), /Expected a positive integer for overlays but received -1 of type number/);
     });
   });
 
@@ -112,6 +153,15 @@ suite('Utilities', () => {
       t.assert.strictEqual(counters.queue, 0);
       t.assert.strictEqual(counters.process, 0);
     });
+
+    test('Accumulate memory usage', async (t) => {
+      const before = sharp.counters();
+      await sharp(fixtures.inputJpg).rotate(90).resize(8).toBuffer();
+      const after = sharp.counters();
+      t.plan(2);
+      t.assert.ok(after.materialised > before.materialised);
+      t.assert.ok(after.memoryPeak >= before.memoryPeak);
+    });
   });
 
   suite('SIMD', () => {